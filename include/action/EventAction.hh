@@ -9,6 +9,7 @@
 #include "TROOT.h"
 #include "TTree.h"
 #include "control/Communicator.hh"
+#include "control/ShowerSplitter.hh"
 #include "globals.hh"
 
 namespace nevod {
@@ -26,12 +27,9 @@ class EventAction : public G4UserEventAction {
 
  private:
   Communicator* communicator_ = nullptr;
-  G4bool header_processed_ = false;
 
-  TFile* output_file_ = nullptr;
-  TTree* run_header_tree_ = nullptr;
-  TTree* event_tree_ = nullptr;
-  G4int current_epoch_ = 0;
+  // shared by the threads, writes the events to the single output file
+  OutputWriter* output_writer_ = nullptr;
 
   EventData* event_data_ = nullptr;
 };
@@ -0,0 +1,49 @@
+#ifndef PARTICLELOOKUP_HH
+#define PARTICLELOOKUP_HH
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "G4ParticleDefinition.hh"
+#include "G4ParticleTable.hh"
+#include "control/Logger.hh"
+#include "globals.hh"
+
+// PDG codes in [-PARTICLE_LOOKUP_RANGE, PARTICLE_LOOKUP_RANGE) are looked up by index
+#define PARTICLE_LOOKUP_RANGE 4096
+
+namespace nevod {
+
+// Per-thread table from PDG code to particle definition. Common codes live in a flat array,
+// the rest (mostly nuclei) are resolved once through the particle table and cached.
+class ParticleLookup {
+  std::vector<G4ParticleDefinition*> table_;
+  std::unordered_map<G4int, G4ParticleDefinition*> other_;
+  G4ParticleTable* particle_table_ = nullptr;
+
+  // codes without a definition and how many primaries had them in this run
+  std::map<G4int, ULong_t> unknown_;
+  // primaries without a direction
+  ULong_t zero_momentum_ = 0;
+
+ public:
+  ParticleLookup() = default;
+
+  ~ParticleLookup() = default;
+
+  // fills the table from the particle table, called at the start of every run
+  void Build();
+
+  // nullptr for unknown codes, they are counted for the run summary
+  G4ParticleDefinition* Find(const ULong_t particle_id);
+
+  // counts a primary skipped for its zero momentum, for the run summary
+  void CountZeroMomentum();
+
+  void PrintSummary() const;
+};
+
+}  // namespace nevod
+
+#endif  // PARTICLELOOKUP_HH
\ No newline at end of file
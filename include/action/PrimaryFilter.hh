@@ -0,0 +1,61 @@
+#ifndef PRIMARYFILTER_HH
+#define PRIMARYFILTER_HH
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "G4PhysicalConstants.hh"
+#include "control/Communicator.hh"
+#include "control/EventData.hh"
+#include "globals.hh"
+
+namespace nevod {
+
+// Culls primaries whose straight line from the start position misses every detector envelope.
+// Envelopes are axis aligned boxes grown by a safety margin, the test is a branchless slab test
+// over the particle columns, so the compiler vectorizes the inner loop.
+class AcceptanceFilter {
+  std::vector<G4double> min_x_, min_y_, min_z_;
+  std::vector<G4double> max_x_, max_y_, max_z_;
+
+ public:
+  AcceptanceFilter(const std::vector<AcceptanceBox>& boxes, const G4double margin);
+
+  ~AcceptanceFilter() = default;
+
+  // start position of particle i is (x[i], y[i], z[i]) - shift, accepted[i] is set to 0 or 1
+  void Apply(const ParticleView& particles, const G4ThreeVector& shift, std::vector<uint8_t>& accepted) const;
+
+  size_t GetBoxNumber() const;
+};
+
+// Number of primaries removed by each cut, a particle is counted by the first cut it fails
+struct FilterCounts {
+  ULong_t species = 0;
+  ULong_t energy = 0;
+  ULong_t time = 0;
+};
+
+// Species, per species energy threshold and arrival time cuts. Every cut is a branchless pass
+// over the particle columns, the PDG tables are expanded into one pass per listed species.
+class PhysicsFilter {
+  PrimaryFilterParams params_;
+  G4bool enabled_ = false;
+
+  std::vector<uint8_t> species_ok_;
+  std::vector<uint8_t> energy_ok_;
+  std::vector<uint8_t> time_ok_;
+
+ public:
+  PhysicsFilter(const PrimaryFilterParams& params);
+
+  ~PhysicsFilter() = default;
+
+  // shower axis (theta, phi in degrees) defines the front plane for the time window, kept[i] is set to 0 or 1
+  FilterCounts Apply(const ParticleView& particles, const G4double theta, const G4double phi, std::vector<uint8_t>& kept);
+};
+
+}  // namespace nevod
+
+#endif  // PRIMARYFILTER_HH
\ No newline at end of file
@@ -4,9 +4,13 @@
 #include <cmath>
 
 #include "G4Event.hh"
-#include "G4ParticleGun.hh"
 #include "G4ParticleTable.hh"
+#include "G4RunManager.hh"
 #include "G4VUserPrimaryGeneratorAction.hh"
+#include "action/ParticleLookup.hh"
+#include "action/PrimaryFilter.hh"
+#include "action/ShowerGenerator.hh"
+#include "action/ShowerTransform.hh"
 #include "control/Communicator.hh"
 #include "control/InputManager.hh"
 #include "globals.hh"
@@ -14,7 +18,7 @@
 namespace nevod {
 
 class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction {
-  G4ParticleGun* particle_gun_ = nullptr;
+  ShowerGenerator* shower_generator_ = nullptr;
   Communicator* communicator_ = nullptr;
   InputManager* input_manager_ = nullptr;
   EventData* event_data_ = nullptr;
@@ -22,13 +26,45 @@ class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction {
   G4String input_path_;
   size_t current_epoch_ = 0;
   size_t epoch_num_ = 0;
-  G4bool header_read_ = false;
   G4bool use_ui = false;
 
   G4double shift_x = 4.5 * m;
   G4double shift_y = 13.0 * m;
   G4double shift_z = (4.5 - 0.3) * m;  // right
 
+  // geometric acceptance of the current event
+  CullingMode culling_mode_{CullingMode::DISABLED};
+  AcceptanceFilter* acceptance_filter_ = nullptr;
+  std::vector<uint8_t> accepted_;
+
+  // physics cuts of the current shower, removed primaries are never tracked
+  PhysicsFilter* physics_filter_ = nullptr;
+  std::vector<uint8_t> kept_;
+  FilterCounts filter_counts_;
+
+  // core position and azimuth of every epoch
+  ShowerTransform* transform_ = nullptr;
+
+  // PDG code to definition, rebuilt for every run
+  ParticleLookup particle_lookup_;
+
+  // primaries launched in the current event
+  std::vector<uint8_t> launch_;
+
+  // chunk of a split shower simulated by this event
+  ShowerChunk chunk_;
+
+  // epochs finished by earlier runs are skipped
+  const Checkpoint* checkpoint_ = nullptr;
+
+  size_t SkipDoneEpochs(size_t epoch) const;
+
+  void FilterPrimaries();
+
+  void CullPrimaries(const ParticleView& particles, const uint8_t* kept);
+
+  void LaunchPrimaries(G4Event* event, const ParticleView& particles, const uint8_t* kept);
+
  public:
   PrimaryGeneratorAction();
 
@@ -38,9 +74,14 @@ class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction {
 
   virtual void GeneratePrimaries(G4Event* event);
 
-  const G4ParticleGun* GetParticleGun() const;
+  const ShowerGenerator* GetShowerGenerator() const;
+
+  // false when the input has no more showers
+  G4bool ReadEvents();
+
+  void BuildParticleLookup();
 
-  void ReadEvents();
+  void PrintParticleSummary() const;
 };
 
 }  // namespace nevod
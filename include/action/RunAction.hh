@@ -12,11 +12,11 @@ class G4Run;
 
 namespace nevod {
 class RunAction : public G4UserRunAction {
-  PrimaryGeneratorAction* primary_generator_action_;
+  PrimaryGeneratorAction* primary_generator_action_ = nullptr;
   Communicator* communicator_;
 
  public:
-  RunAction(Communicator* communicator);
+  RunAction(Communicator* communicator, PrimaryGeneratorAction* primary_generator_action = nullptr);
   ~RunAction() override;
 
   void BeginOfRunAction(const G4Run* run) override;
@@ -0,0 +1,63 @@
+#ifndef SHOWERGENERATOR_HH
+#define SHOWERGENERATOR_HH
+
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "G4Event.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4ThreeVector.hh"
+#include "G4VPrimaryGenerator.hh"
+#include "action/ParticleLookup.hh"
+#include "control/EventData.hh"
+#include "globals.hh"
+
+namespace nevod {
+
+// Builds the primary vertices of a whole shower straight from the particle columns.
+// Particles starting at the same point share one vertex, vertices and primaries come
+// from the Geant4 allocator pools, so no gun state is reconfigured per particle.
+class ShowerGenerator : public G4VPrimaryGenerator {
+  struct Origin {
+    Double_t x, y, z;
+
+    G4bool operator==(const Origin& other) const { return x == other.x && y == other.y && z == other.z; }
+  };
+
+  struct OriginHash {
+    size_t operator()(const Origin& origin) const;
+  };
+
+  const ParticleView* particles_ = nullptr;
+  const uint8_t* launch_ = nullptr;
+  G4ThreeVector shift_{};
+  ParticleLookup* lookup_ = nullptr;
+  G4ParticleDefinition* definition_ = nullptr;
+
+  std::unordered_map<Origin, G4PrimaryVertex*, OriginHash> vertices_;
+  size_t last_launched_ = 0;
+  size_t launched_num_ = 0;
+
+ public:
+  ShowerGenerator(ParticleLookup* lookup);
+
+  ~ShowerGenerator() override = default;
+
+  // particle i starts at (x[i], y[i], z[i]) - shift and is launched when launch[i] is set
+  void SetPrimaries(const ParticleView& particles, const uint8_t* launch, const G4ThreeVector& shift);
+
+  // replaces the species of every primary when set (geantino for visualisation)
+  void SetDefinition(G4ParticleDefinition* definition);
+
+  void GeneratePrimaryVertex(G4Event* event) override;
+
+  // index of the last launched particle in the view, valid when GetLaunchedNumber() > 0
+  size_t GetLastLaunched() const;
+  size_t GetLaunchedNumber() const;
+};
+
+}  // namespace nevod
+
+#endif  // SHOWERGENERATOR_HH
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef SHOWERTRANSFORM_HH
+#define SHOWERTRANSFORM_HH
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "G4SystemOfUnits.hh"
+#include "control/Communicator.hh"
+#include "control/EventData.hh"
+#include "globals.hh"
+
+namespace nevod {
+
+// Epoch-level transform of a reused shower: rotation around the vertical axis through the core,
+// then displacement of the core inside the configured area. Random numbers come from a counter
+// based generator keyed by (seed, shower, epoch), so every epoch is reproducible on any thread.
+class ShowerTransform {
+  EpochTransformParams params_;
+  uint64_t seed_ = 0;
+
+  // transformed columns of the current event
+  std::vector<Double_t> x_, y_, px_, py_;
+
+  static uint64_t Mix(uint64_t value);
+
+ public:
+  // truth of the last applied transform
+  Double_t core_x = 0, core_y = 0;  // in mm
+  Double_t rotation = 0;            // in degrees
+
+  ShowerTransform(const EpochTransformParams& params, G4int seed);
+
+  ~ShowerTransform() = default;
+
+  G4bool IsEnabled() const;
+
+  // key of a shower, taken from its header and size so it does not depend on where the file was read
+  static uint64_t GetShowerKey(const Shower& shower);
+
+  // view of particles [begin, end) moved to the epoch core, untouched columns point into the shower
+  ParticleView Apply(const Shower& shower, G4int epoch, size_t begin, size_t end);
+};
+
+}  // namespace nevod
+
+#endif  // SHOWERTRANSFORM_HH
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef STEPPINGACTION_HH
 #define STEPPINGACTION_HH
 
+#include "G4EventManager.hh"
 #include "G4UImanager.hh"
 #include "G4UserSteppingAction.hh"
 #include "control/Communicator.hh"
@@ -0,0 +1,156 @@
+#ifndef CHANNELID_HH
+#define CHANNELID_HH
+
+#include <algorithm>
+
+#include "globals.hh"
+
+namespace nevod {
+
+struct PMTId {
+  G4int plane;
+  G4int stripe;
+  G4int module;
+  G4int tube;
+};
+
+struct CounterId {
+  G4int side;
+  G4int plane;
+  G4int row;
+};
+
+// Index ranges of one detector configuration. Even planes hold the largest stripes and modules,
+// odd planes may hold fewer.
+struct CWDLayout {
+  G4int plane_num;
+  G4int stripe_num;
+  G4int module_num;
+  G4int tube_num;
+  G4int odd_stripe_num;
+  G4int odd_module_num;
+
+  constexpr G4int StripeNumber(G4int plane) const { return plane % 2 == 0 ? stripe_num : odd_stripe_num; }
+  constexpr G4int ModuleNumber(G4int plane) const { return plane % 2 == 0 ? module_num : odd_module_num; }
+};
+
+// Odd planes hold the largest rows, even planes may hold fewer
+struct SCTLayout {
+  G4int side_num;
+  G4int plane_num;
+  G4int row_num;
+  G4int even_row_num;
+
+  constexpr G4int RowNumber(G4int plane) const { return plane % 2 == 0 ? even_row_num : row_num; }
+
+  constexpr G4int CounterNumber() const {
+    G4int counters = 0;
+    for (G4int plane = 0; plane < plane_num; ++plane)
+      counters += RowNumber(plane);
+    return side_num * counters;
+  }
+};
+
+// Every configuration, a new one is a new entry. Planes of the old CWD alternate between 4x4 and
+// 3x3 modules, SCT planes alternate along y between 4 and 5 counters.
+inline constexpr CWDLayout CWD_LAYOUTS[] = {{7, 4, 4, 6, 3, 3}, {6, 4, 4, 6, 4, 4}};
+inline constexpr SCTLayout SCT_LAYOUTS[] = {{2, 9, 5, 4}, {2, 13, 5, 4}};
+
+inline constexpr const CWDLayout& CWD_OLD_LAYOUT = CWD_LAYOUTS[0];
+inline constexpr const CWDLayout& CWD_NEW_LAYOUT = CWD_LAYOUTS[1];
+inline constexpr const SCTLayout& SCT_OLD_LAYOUT = SCT_LAYOUTS[0];
+inline constexpr const SCTLayout& SCT_NEW_LAYOUT = SCT_LAYOUTS[1];
+
+// bits holding every index below size
+constexpr G4int BitWidth(G4int size) {
+  G4int bits = 0;
+  while ((1 << bits) < size)
+    ++bits;
+  return bits;
+}
+
+constexpr G4int BitMask(G4int bits) { return (1 << bits) - 1; }
+
+// bits holding one index of every layout
+template <typename Layout, size_t N>
+constexpr G4int FieldBits(const Layout (&layouts)[N], G4int Layout::*size) {
+  G4int bits = 0;
+  for (const auto& layout: layouts)
+    bits = std::max(bits, BitWidth(layout.*size));
+  return bits;
+}
+
+// Copy number of a photocathode, bit fields from the lowest: tube, module, stripe, plane.
+// The fields are wide enough for every layout, so decoding needs no geometry.
+struct PMTChannel {
+  static constexpr G4int TUBE_BITS = FieldBits(CWD_LAYOUTS, &CWDLayout::tube_num);
+  static constexpr G4int MODULE_BITS = FieldBits(CWD_LAYOUTS, &CWDLayout::module_num);
+  static constexpr G4int STRIPE_BITS = FieldBits(CWD_LAYOUTS, &CWDLayout::stripe_num);
+  static constexpr G4int PLANE_BITS = FieldBits(CWD_LAYOUTS, &CWDLayout::plane_num);
+
+  static constexpr G4int MODULE_SHIFT = TUBE_BITS;
+  static constexpr G4int STRIPE_SHIFT = MODULE_SHIFT + MODULE_BITS;
+  static constexpr G4int PLANE_SHIFT = STRIPE_SHIFT + STRIPE_BITS;
+
+  // every channel id is below this
+  static constexpr G4int SIZE = 1 << (PLANE_SHIFT + PLANE_BITS);
+
+  static constexpr G4int Encode(const PMTId& id) {
+    return id.plane << PLANE_SHIFT | id.stripe << STRIPE_SHIFT | id.module << MODULE_SHIFT | id.tube;
+  }
+
+  static constexpr PMTId Decode(const G4int channel) {
+    return {channel >> PLANE_SHIFT,
+            channel >> STRIPE_SHIFT & BitMask(STRIPE_BITS),
+            channel >> MODULE_SHIFT & BitMask(MODULE_BITS),
+            channel & BitMask(TUBE_BITS)};
+  }
+
+  // the last index of every field survives the round trip
+  static constexpr G4bool Fits(const CWDLayout& layout) {
+    if (layout.odd_stripe_num > layout.stripe_num || layout.odd_module_num > layout.module_num) return false;
+    PMTId last{layout.plane_num - 1, layout.stripe_num - 1, layout.module_num - 1, layout.tube_num - 1};
+    PMTId id = Decode(Encode(last));
+    return id.plane == last.plane && id.stripe == last.stripe && id.module == last.module && id.tube == last.tube;
+  }
+};
+
+// Copy number of an SCT counter, bit fields from the lowest: row, plane, side
+struct SCTChannel {
+  static constexpr G4int ROW_BITS = FieldBits(SCT_LAYOUTS, &SCTLayout::row_num);
+  static constexpr G4int PLANE_BITS = FieldBits(SCT_LAYOUTS, &SCTLayout::plane_num);
+  static constexpr G4int SIDE_BITS = FieldBits(SCT_LAYOUTS, &SCTLayout::side_num);
+
+  static constexpr G4int PLANE_SHIFT = ROW_BITS;
+  static constexpr G4int SIDE_SHIFT = PLANE_SHIFT + PLANE_BITS;
+
+  static constexpr G4int SIZE = 1 << (SIDE_SHIFT + SIDE_BITS);
+
+  static constexpr G4int Encode(const CounterId& id) { return id.side << SIDE_SHIFT | id.plane << PLANE_SHIFT | id.row; }
+
+  static constexpr CounterId Decode(const G4int channel) {
+    return {channel >> SIDE_SHIFT, channel >> PLANE_SHIFT & BitMask(PLANE_BITS), channel & BitMask(ROW_BITS)};
+  }
+
+  static constexpr G4bool Fits(const SCTLayout& layout) {
+    if (layout.even_row_num > layout.row_num) return false;
+    CounterId last{layout.side_num - 1, layout.plane_num - 1, layout.row_num - 1};
+    CounterId id = Decode(Encode(last));
+    return id.side == last.side && id.plane == last.plane && id.row == last.row;
+  }
+};
+
+template <typename Channel, typename Layout, size_t N>
+constexpr G4bool FitAll(const Layout (&layouts)[N]) {
+  for (const auto& layout: layouts)
+    if (!Channel::Fits(layout)) return false;
+  return true;
+}
+
+// copy numbers stay positive and every layout is encoded without loss
+static_assert(PMTChannel::PLANE_SHIFT + PMTChannel::PLANE_BITS < 31 && FitAll<PMTChannel>(CWD_LAYOUTS), "CWD layout does not fit the channel id");
+static_assert(SCTChannel::SIDE_SHIFT + SCTChannel::SIDE_BITS < 31 && FitAll<SCTChannel>(SCT_LAYOUTS), "SCT layout does not fit the channel id");
+
+}  // namespace nevod
+
+#endif  // CHANNELID_HH
\ No newline at end of file
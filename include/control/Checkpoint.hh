@@ -0,0 +1,69 @@
+#ifndef CHECKPOINT_HH
+#define CHECKPOINT_HH
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "control/Logger.hh"
+#include "globals.hh"
+
+#define CHECKPOINT_PREFIX "checkpoint"
+#define CHECKPOINT_EXTENSION ".tsv"
+
+namespace fs = std::filesystem;
+
+namespace nevod {
+
+// Completed (file, epoch) units of a production run. The output writer appends its units to
+// <output_dir>/checkpoint<suffix>.tsv as "<file>\t<epoch>" lines, once the matching events
+// are saved in the output shard. Files are named relative to the canonical input directory. Resumed runs write new shards with the suffix "_part<N>"
+// and skip every unit listed by the earlier ones. Reading the checkpoints has no side effects,
+// a fresh run removes the old ones only when it opens its output.
+class Checkpoint {
+  std::string output_dir_;
+  G4int shard_ = 0;
+  std::map<std::string, std::set<G4int>> done_;
+
+ public:
+  Checkpoint() = default;
+
+  Checkpoint(const std::string& output_dir, G4bool resume);
+
+  ~Checkpoint() = default;
+
+  // suffix of output and checkpoint files written by this run
+  std::string GetShardSuffix() const;
+
+  G4bool IsDone(const std::string& file, G4int epoch) const;
+
+  // finished epochs of the file below epoch_num
+  G4int GetDoneNumber(const std::string& file, G4int epoch_num) const;
+
+  size_t GetUnitNumber() const;
+
+  // removes the checkpoints of an earlier run, returns their number
+  static size_t RemoveFiles(const std::string& output_dir);
+};
+
+// List of units waiting for the next save of the output shard
+class CheckpointWriter {
+  std::ofstream file_;
+  std::vector<std::pair<std::string, G4int>> pending_;
+
+ public:
+  CheckpointWriter(const std::string& path);
+
+  ~CheckpointWriter() = default;
+
+  void Add(const std::string& file, G4int epoch);
+
+  // call after the output shard is saved, units are durable from then on
+  void Flush();
+};
+
+}  // namespace nevod
+
+#endif  // CHECKPOINT_HH
\ No newline at end of file
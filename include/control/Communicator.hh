@@ -8,9 +8,17 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
 
 #include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4ThreeVector.hh"
+#include "control/ChannelId.hh"
+#include "control/Checkpoint.hh"
 #include "control/EventData.hh"
+#include "control/Logger.hh"
+#include "control/OutputMerger.hh"
+#include "control/OutputWriter.hh"
 #include "globals.hh"
 
 namespace fs = std::filesystem;
@@ -32,22 +40,36 @@ enum struct CherenkovConfig {
   NEW_CONFIGURATION
 };
 
-struct PMTId {
-  G4int plane;
-  G4int stripe;
-  G4int module;
-  G4int tube;
-};
-
 enum struct SCTConfig {
   OLD_CONFIGURATION,
   NEW_CONFIGURATION
 };
 
-struct CounterId {
-  G4int side;
-  G4int plane;
-  G4int row;
+struct AcceptanceBox {
+  G4ThreeVector center;
+  G4ThreeVector half_size;
+};
+
+enum struct CullingMode {
+  DISABLED,
+  FLAG,  // only count primaries outside the acceptance
+  DROP   // do not track them at all
+};
+
+// Physics cuts applied to shower primaries before tracking
+struct PrimaryFilterParams {
+  G4double default_energy_threshold = 0;            // in GeV
+  std::map<G4int, G4double> energy_thresholds{};    // PDG code -> minimum energy in GeV
+  std::vector<G4int> species_whitelist{};           // keep only these when not empty
+  std::vector<G4int> species_blacklist{};
+  G4bool use_time_window = false;
+  G4double time_window_min = 0, time_window_max = 0;  // from the shower front plane
+};
+
+// Transform applied to a reused shower in every epoch
+struct EpochTransformParams {
+  G4double core_half_x = 0, core_half_y = 0;  // in mm, core is displaced uniformly inside this area
+  G4bool random_azimuth = false;
 };
 
 struct SimulationParams {
@@ -55,16 +77,40 @@ struct SimulationParams {
   G4int epoch_num = 1000;
   G4int batch_size{};
   G4int initial_offset = 0;
+  G4int prefetch_depth = 4;
+  G4int io_thread_num = 2;
+  G4int discovery_thread_num = -1;
+  G4int shower_store_size = 0;  // in MB, 0 disables the store, it only helps when files are read again
+  G4int lease_size = 4;
+  CullingMode culling_mode{CullingMode::DISABLED};
+  G4double culling_margin = 5. * m;
+  G4int split_threshold = 0;  // particles, showers this large run in chunks (0 disables)
+  G4int split_chunk_num = 4;
+  PrimaryFilterParams primary_filter{};
+  EpochTransformParams epoch_transform{};
   std::string input_path{};
+  std::string input_stream_path{};  // FIFO or Unix socket, replaces the input files when set
+  G4int stream_shower_num = 0;      // showers to simulate from the stream
   std::string output_dir_path{};
+  G4bool resume = false;             // skip units listed by the checkpoints in output_dir_path
+  G4int checkpoint_interval = 100;   // events between saves of the output shard
+  G4int output_queue_size = 256;     // events waiting for the writer thread
+  G4int output_flush_interval = 10;  // events between flushes of the output file (0 only on checkpoints)
+  OutputFormat output_format{OutputFormat::TTREE};
+  OutputPolicy output_policy{};
+  G4bool merge_output = true;        // merge the output shards into merged.root after the run
+  G4int merge_thread_num = -1;
+  G4bool merge_sort = false;  // order merged events by (input file, epoch, event id)
+  G4bool merge_delete_inputs = false;
   G4bool verbose = true;
   CherenkovConfig config_qsm{CherenkovConfig::NEW_CONFIGURATION};
   SCTConfig config_sct{SCTConfig::NEW_CONFIGURATION};
   ConstructionFlags construction_flags;
   G4bool use_ui = false;
   G4int seed = 47212;
-  G4bool save_logs = true;
+  G4bool save_logs = true;  // per-thread log files in log_save_dir_path, otherwise the log goes to G4cout
   std::string log_save_dir_path{};
+  LogLevel log_level{LogLevel::INFO};
 
   SimulationParams() = default;
 
@@ -73,10 +119,22 @@ struct SimulationParams {
   ~SimulationParams() = default;
 };
 
+// Event state of one worker thread
+struct EventContext {
+  EventData* event_data = nullptr;
+  G4int current_epoch = 0;
+};
+
+// Shared state of the run. The configuration and the detector description are written by the
+// master before the workers start and only read afterwards, so the getters used while tracking
+// take no locks. The event state lives in a thread-local context.
 class Communicator {
  public:
   Communicator(const G4String& config_path);
 
+  // touches no files until the output is opened, for tools that need only the event state
+  Communicator(const SimulationParams& params);
+
   ~Communicator();
 
   void PrintStartMessage() const;
@@ -87,19 +145,32 @@ class Communicator {
   void SetTotalEventCount(const G4int total_event_count);
   void SetCountPMT(const G4int count_pmt);
   void SetCountSCT(const G4int count_sct);
+  // placed channels, they size the event arrays and list the channels of the sparse output
   void SetQSMId(const std::vector<PMTId>& id_qsm);
   void SetCounterId(const std::vector<CounterId>& id_sct);
   void SetCurrentEpoch(const G4int current_epoch);
+  void AddAcceptanceBox(const G4ThreeVector& center, const G4ThreeVector& half_size);
+
+  // sizes the event buffers of the calling thread from the geometry, before its first event
+  void AllocateEventData();
 
-  SimulationParams& GetSimulationParams();
+  // started by the first caller, once the geometry is known
+  OutputWriter* GetOutputWriter();
+  // waits for the writer to save every pushed event, call after the run
+  void CloseOutput();
+  // (file, epoch) units in the output, valid after CloseOutput
+  size_t GetWrittenUnitNumber() const;
+
+  const SimulationParams& GetSimulationParams() const;
+  // event data of the calling thread, created by its first call
   EventData* GetEventData();
-  G4int GetCountPMT();
-  G4int GetCountSCT();
-  G4int GetMaxStepCount();
-  G4int GetTotalEpochNum();
-  G4int GetCurrentEpoch();
-  PMTId GetQSMId(const G4int copy_number);
-  CounterId GetCounterId(const G4int copy_number);
+  G4int GetCountPMT() const;
+  G4int GetCountSCT() const;
+  G4int GetMaxStepCount() const;
+  G4int GetTotalEpochNum() const;
+  G4int GetCurrentEpoch() const;
+  const std::vector<AcceptanceBox>& GetAcceptanceBoxes() const;
+  const Checkpoint& GetCheckpoint() const;
   std::chrono::steady_clock::time_point GetEventStartTime();
 
  private:
@@ -115,13 +186,21 @@ class Communicator {
   G4int count_sct_ = 0;
   std::vector<PMTId> id_qsm_{};
   std::vector<CounterId> id_sct_{};
+  std::vector<AcceptanceBox> acceptance_boxes_{};
+  EventLayout event_layout_{};
+
+  // units finished by earlier runs, read once at startup
+  Checkpoint checkpoint_{};
+
+  OutputWriter* output_writer_ = nullptr;
 
-  // massive of event data (for each thread)
-  std::vector<EventData*> event_data_{nullptr};
-  std::vector<G4int> current_epoch_{0};
+  // event data of every thread that asked for it, owned here and reached through context_
+  std::vector<EventData*> event_data_{};
+  static G4ThreadLocal EventContext context_;
+  // guards the setters and the first call of every thread, never taken while tracking
   G4Mutex mutex_ = G4MUTEX_INITIALIZER;
 
-  void ResetEventData();
+  void UpdateEventLayout();
 };
 }  // namespace nevod
 
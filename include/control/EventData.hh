@@ -1,8 +1,16 @@
 #ifndef EVENT_DATA_HH
 #define EVENT_DATA_HH
 
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "Compression.h"
 #include "G4RandomTools.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4ThreeVector.hh"
@@ -15,6 +23,10 @@
 #include "TVector3.h"
 #include "globals.hh"
 
+#ifdef NEVOD_WITH_RNTUPLE
+#include <ROOT/RNTupleModel.hxx>
+#endif
+
 // Template for 3D vector
 template <typename T>
 using vector3d = std::vector<std::vector<std::vector<T>>>;
@@ -35,8 +47,100 @@ vector4d<T> init_vector4d(size_t dim1, size_t dim2, size_t dim3, size_t dim4, T
   return vector4d<T>(dim1, std::vector<std::vector<std::vector<T>>>(dim2, std::vector<std::vector<T>>(dim3, std::vector<T>(dim4, init_value))));
 }
 
+// particle_id, particle_num, x, y, z, px, py, pz, energy
+#define PARTICLE_COLUMN_NUM 9
+
 namespace nevod {
 
+// Flat row-major array with a fixed shape, element (i, j, ...) lives at i * strides[0] + j * strides[1] + ...
+// Data and shape are written as plain branches, so the output needs no nested STL streamer.
+// Storage is sized once by Resize and only zeroed between events; build with NEVOD_BOUNDS_CHECK to check every index.
+template <typename T, size_t Rank>
+struct FlatArray {
+  std::vector<T> data{};
+  std::vector<Int_t> shape{};  // index schema written next to the data
+  std::array<size_t, Rank> strides{};
+
+  void Resize(const std::array<size_t, Rank>& new_shape) {
+    size_t size = 1;
+    shape.resize(Rank);
+    for (size_t i = Rank; i-- > 0;) {
+      strides[i] = size;
+      shape[i] = new_shape[i];
+      size *= new_shape[i];
+    }
+    data.assign(size, T{});
+  }
+
+  template <typename... Index>
+  size_t Offset(Index... index) const {
+    static_assert(sizeof...(Index) == Rank, "one index per dimension");
+    size_t offset = 0, dimension = 0;
+#ifdef NEVOD_BOUNDS_CHECK
+    const size_t indices[] = {size_t(index)...};
+    if (shape.size() != Rank) throw std::out_of_range("FlatArray is not allocated");
+    for (size_t i = 0; i < Rank; ++i)
+      if (indices[i] >= size_t(shape[i]))
+        throw std::out_of_range("FlatArray index " + std::to_string(indices[i]) + " is out of " + std::to_string(shape[i]) + " in dimension " +
+                                std::to_string(i));
+#endif
+    ((offset += size_t(index) * strides[dimension++]), ...);
+    return offset;
+  }
+
+  template <typename... Index>
+  T& operator()(Index... index) {
+    return data[Offset(index...)];
+  }
+
+  template <typename... Index>
+  const T& operator()(Index... index) const {
+    return data[Offset(index...)];
+  }
+
+  // keeps the shape and the storage
+  void Zero() { std::fill(data.begin(), data.end(), T{}); }
+
+  void Clear() {
+    data.clear();
+    shape.clear();
+    strides = {};
+  }
+
+  size_t size() const { return data.size(); }
+  G4bool empty() const { return data.empty(); }
+};
+
+// Non-zero channels of a detector array, written instead of the dense data in the sparse output mode
+struct SparseArray {
+  std::vector<Int_t> channel{};
+  std::vector<Double_t> value{};
+
+  // channels[c] is the dense offset of channel c, without a channel map the dense offset is the channel
+  template <typename T, size_t Rank>
+  void Compress(const FlatArray<T, Rank>& dense, const std::vector<size_t>& channels) {
+    Clear();
+    if (channels.empty()) {
+      for (size_t i = 0; i < dense.size(); ++i)
+        if (dense.data[i] != T{}) Add(i, dense.data[i]);
+      return;
+    }
+    for (size_t i = 0; i < channels.size(); ++i)
+      if (dense.data[channels[i]] != T{}) Add(i, dense.data[channels[i]]);
+  }
+
+  void Add(size_t new_channel, Double_t new_value) {
+    channel.push_back(new_channel);
+    value.push_back(new_value);
+  }
+
+  // keeps the storage
+  void Clear() {
+    channel.clear();
+    value.clear();
+  }
+};
+
 struct TrackData {
   G4int detected_copy_num = -1;
   G4ThreeVector coordinate{};
@@ -52,11 +156,12 @@ struct ParticleData {
   Double_t energy{};  // in GeV
 };
 
+// Columnar particle list, coordinates and momenta are split per axis
 struct Particles {
   std::vector<ULong_t> particle_id{};
   std::vector<ULong_t> particle_num{};
-  std::vector<TVector3> coordinate{};  // in metres
-  std::vector<TVector3> momentum{};
+  std::vector<Double_t> x{}, y{}, z{};  // in metres
+  std::vector<Double_t> px{}, py{}, pz{};
   std::vector<Double_t> energy{};  // in GeV
 
   Particles() = default;
@@ -66,19 +171,104 @@ struct Particles {
   void push_back(const ULong_t particle_id, const ULong_t particle_num, const TVector3 coordinate, const TVector3 momentum, const Double_t energy);
 
   void resize(const size_t size);
+  void reserve(const size_t size);
   void clear();
   ParticleData operator[](const size_t index) const;
   size_t size() const;
 };
 
+// Read-only view of particle columns, either owned by Particles or mapped from a native shower file
+struct ParticleView {
+  size_t size = 0;
+  const ULong_t* particle_id = nullptr;
+  const ULong_t* particle_num = nullptr;
+  const Double_t *x = nullptr, *y = nullptr, *z = nullptr;  // in metres
+  const Double_t *px = nullptr, *py = nullptr, *pz = nullptr;
+  const Double_t* energy = nullptr;  // in GeV
+};
+
+// Decoded input shower, shared read-only between the input manager and event data
+struct Shower {
+  std::string source;  // checkpoint key of the input file, empty for streamed showers
+  ULong_t event_id{};
+  ULong_t primary_particle_id{};
+  ULong_t particle_amount{};
+  Double_t theta{}, phi{};  // in degrees
+
+  // owned columns (empty for mapped showers)
+  Particles particles;
+
+  // columns used for primary generation
+  ParticleView view;
+
+  // keeps the mapped file alive as long as the shower
+  std::shared_ptr<const void> mapping;
+
+  void BindView();
+};
+
+using ShowerPtr = std::shared_ptr<const Shower>;
+
+class SplitShower;
+
+// Shapes of the detector arrays, taken from the geometry
+struct EventLayout {
+  std::array<size_t, 3> sct{};    // side, plane, row
+  std::array<size_t, 3> decor{};  // supermodule, chamber, side
+  std::array<size_t, 4> qsm{};    // plane, stripe, module, tube
+  size_t pmt_num = 0;             // photoelectron counters, one per PMT channel id
+
+  // dense offsets of the PMTs and SCT counters in placement order, channel ids of the sparse output
+  std::vector<size_t> qsm_channels{};
+  std::vector<size_t> sct_channels{};
+};
+
+// How the event data is stored, recorded in every output file
+struct OutputPolicy {
+  G4bool sparse = false;                // non-zero detector channels only
+  G4bool compact_types = false;         // DECOR flags as 8 bit, counts as 32 bit integers
+  G4bool float_precision = false;       // amplitudes and energies as 32 bit floats
+  std::string compression = "default";  // "default", "none", "zlib", "lzma", "lz4" or "zstd"
+  G4int compression_level = 5;
+
+  // ROOT compression settings of the file, -1 keeps the ROOT default
+  G4int GetCompressionSettings() const;
+
+  std::string Describe() const;
+};
+
 struct EventData {
+  std::string source;  // input file of the shower, empty for streamed showers
   ULong_t event_id{};
   ULong_t primary_particle_id{};
   ULong_t particle_amount{};
   Double_t theta{}, phi{};  // in degrees
 
   // Initial data
-  Particles particles;
+  ShowerPtr shower;
+
+  // Primaries outside the detector acceptance
+  ULong_t culled_count{};
+  Double_t culled_energy{};  // in GeV
+
+  // Header entry is written with the first event of a new shower
+  G4bool header_pending = false;
+
+  // Set when the input ended before this event and nothing was launched
+  G4bool input_ended = false;
+
+  // Set when the event is one chunk of a split shower
+  std::shared_ptr<SplitShower> split;
+  G4int split_epoch = 0;
+
+  // Primaries removed by the physics cuts
+  ULong_t filtered_species{};
+  ULong_t filtered_energy{};
+  ULong_t filtered_time{};
+
+  // Epoch transform of the shower
+  Double_t core_x{}, core_y{};  // in metres
+  Double_t rotation{};          // in degrees
 
   // Data after simulation
   Double_t theta_rec{}, phi_rec{};  // in degrees
@@ -96,30 +286,80 @@ struct EventData {
   // NEVOD
   std::pair<TrackData, TrackData> muon_nevod;
 
-  // DECOR
-  vector3d<Double_t> muon_decor;
-  vector3d<Double_t> muon_decor_w;
+  // DECOR (supermodule, chamber, side)
+  FlatArray<Double_t, 3> muon_decor;
+  FlatArray<Double_t, 3> muon_decor_w;
 
-  // SCT
-  vector3d<Double_t> edep_count_sct;
+  // SCT (side, plane, row)
+  FlatArray<Double_t, 3> edep_count_sct;
 
   // CWD NEVOD
   std::vector<Int_t> photoelectron_num;
 
-  vector4d<Double_t> amplitude_qsm;
+  // amplitudes (plane, stripe, module, tube)
+  FlatArray<Double_t, 4> amplitude_qsm;
+
+  // non-zero channels of the arrays above, filled only for the sparse output
+  SparseArray sparse_decor, sparse_decor_w, sparse_sct, sparse_qsm;
 
   EventData();
   EventData(ULong_t event_id, ULong_t primary_particle_id, ULong_t particle_amount, Double_t theta, Double_t phi);
 
   ~EventData() = default;
 
+  // columns replaces the copy of a mapped shower, the caller keeps it alive while the shower is set
+  void SetShower(ShowerPtr new_shower, Particles* columns = nullptr);
+
+  // false for mapped showers, which have to be copied into columns for the output
+  static G4bool HasColumns(const Shower& shower);
+
   void ConnectHeaderTree(TTree* tree);
-  void ConnectEventTree(TTree* tree);
+  // sparse output writes (channel, value) pairs instead of the dense detector arrays
+  void ConnectEventTree(TTree* tree, const OutputPolicy& policy = {});
+
+#ifdef NEVOD_WITH_RNTUPLE
+  // same columns as the trees, the returned function copies the event into the model fields before a fill
+  std::function<void()> ConnectHeaderNTuple(ROOT::Experimental::RNTupleModel& model);
+  std::function<void()> ConnectEventNTuple(ROOT::Experimental::RNTupleModel& model, const OutputPolicy& policy = {});
+#endif
+
+  // fills the narrow columns of the policy, call before every fill of the event
+  void PrepareOutput(const OutputPolicy& policy);
 
   void Print() const;
   std::ostream& operator<<(std::ostream& os) const;
 
+  // sizes the detector arrays, done once per thread before the first event
+  void Allocate(const EventLayout& layout);
+
+  // zeroes the detector arrays in place, they are never reallocated between events
   void Clear(G4bool clear_header = true);
+
+  // adds the detector response of another chunk of the same event
+  void Accumulate(const EventData& other);
+
+ private:
+  // narrow copies written instead of the full precision columns, dense arrays or sparse values
+  struct NarrowColumns {
+    UInt_t particle_count{}, muon_count{}, culled_count{};
+    Float_t energy_dep{}, energy_start{}, energy_end{}, culled_energy{};
+    std::vector<UChar_t> decor, decor_w;
+    std::vector<Float_t> sct, qsm;
+  } narrow_;
+
+  // mapped showers have no owned columns, they are copied here once per shower for the output
+  Particles mapped_particles_;
+
+  // event tree reads the shower columns through these pointers, so swapping showers never copies them
+  std::vector<ULong_t>* particle_id_column_ = nullptr;
+  std::vector<ULong_t>* particle_num_column_ = nullptr;
+  std::vector<Double_t>* x_column_ = nullptr;
+  std::vector<Double_t>* y_column_ = nullptr;
+  std::vector<Double_t>* z_column_ = nullptr;
+  std::vector<Double_t>* px_column_ = nullptr;
+  std::vector<Double_t>* py_column_ = nullptr;
+  std::vector<Double_t>* pz_column_ = nullptr;
+  std::vector<Double_t>* energy_column_ = nullptr;
 };
 
 }  // namespace nevod
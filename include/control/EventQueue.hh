@@ -0,0 +1,82 @@
+#ifndef EVENTQUEUE_HH
+#define EVENTQUEUE_HH
+
+#include <atomic>
+#include <memory>
+
+#include "globals.hh"
+
+namespace nevod {
+
+// Bounded lock-free ring for many producers and one consumer. Every slot carries a sequence
+// number telling whose turn it is, so producers only race on the push position. Items live in
+// the slots and are filled in place, a reused slot keeps the capacity of its vectors.
+template <typename T>
+class EventQueue {
+  struct Slot {
+    std::atomic<size_t> sequence{0};
+    T item{};
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_ = 0;
+
+  alignas(64) std::atomic<size_t> push_position_{0};
+  alignas(64) size_t pop_position_ = 0;  // owned by the consumer
+
+ public:
+  // capacity is rounded up to a power of two
+  explicit EventQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity)
+      size <<= 1;
+
+    slots_ = std::make_unique<Slot[]>(size);
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; ++i)
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  ~EventQueue() = default;
+
+  // claims a free slot to fill, nullptr when the queue is full
+  T* BeginPush(size_t& ticket) {
+    size_t position = push_position_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot& slot = slots_[position & mask_];
+      size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+
+      if (difference == 0) {
+        if (push_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          ticket = position;
+          return &slot.item;
+        }
+      } else if (difference < 0) {
+        return nullptr;
+      } else {
+        position = push_position_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // publishes the filled slot to the consumer
+  void EndPush(size_t ticket) { slots_[ticket & mask_].sequence.store(ticket + 1, std::memory_order_release); }
+
+  // next published item, nullptr when there is none yet
+  T* BeginPop() {
+    Slot& slot = slots_[pop_position_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != pop_position_ + 1) return nullptr;
+    return &slot.item;
+  }
+
+  // hands the slot back to the producers
+  void EndPop() {
+    slots_[pop_position_ & mask_].sequence.store(pop_position_ + mask_ + 1, std::memory_order_release);
+    ++pop_position_;
+  }
+};
+
+}  // namespace nevod
+
+#endif  // EVENTQUEUE_HH
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef FILESCHEDULER_HH
+#define FILESCHEDULER_HH
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "G4AutoLock.hh"
+#include "globals.hh"
+
+namespace nevod {
+
+// Hands out file indices to threads in leased batches kept in per-thread deques.
+// A thread whose deque runs dry leases the next batch, or steals half of another deque
+// once everything is leased. Every file is handed out once, so each of them is simulated by
+// exactly one thread. Dropped files are skipped by every later request. The lanes belong to the threads that read
+// the files: the I/O threads when showers are prefetched, the workers otherwise.
+class FileScheduler {
+  struct Lane {
+    G4Mutex mutex = G4MUTEX_INITIALIZER;
+    std::deque<size_t> files;
+  };
+
+  std::vector<size_t> order_;  // file indices in lease order
+  std::vector<std::unique_ptr<Lane>> lanes_;
+  size_t lease_size_ = 1;
+
+  std::unique_ptr<std::atomic<G4bool>[]> dropped_;  // by file index
+  std::atomic<size_t> live_num_{0};
+
+  std::atomic<size_t> next_{0};
+  std::atomic<size_t> lane_counter_{0};
+  size_t generation_ = 0;  // unique per Reset, threads take a new lane after it
+
+  size_t GetLane();
+  G4bool Lease(Lane& lane);
+  G4bool Steal(Lane& thief);
+
+ public:
+  FileScheduler() = default;
+
+  ~FileScheduler() = default;
+
+  // not thread safe, call before the threads start asking for files
+  void Reset(const std::vector<size_t>& order, size_t lane_num, size_t lease_size);
+
+  // false once every file is handed out or dropped
+  G4bool Next(size_t& file);
+
+  // returns false when the file was already dropped
+  G4bool Drop(size_t file);
+
+  // files not dropped so far
+  size_t GetLiveNumber() const;
+};
+
+}  // namespace nevod
+
+#endif  // FILESCHEDULER_HH
\ No newline at end of file
@@ -1,34 +1,73 @@
 #ifndef INPUTMANAGER_HH
 #define INPUTMANAGER_HH
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <deque>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 #include "G4AutoLock.hh"
+#include "TBranch.h"
 #include "TFile.h"
 #include "TMath.h"
 #include "TROOT.h"
 #include "TTree.h"
 #include "control/Communicator.hh"
+#include "control/FileScheduler.hh"
+#include "control/InputManifest.hh"
+#include "control/ShowerFile.hh"
+#include "control/ShowerSplitter.hh"
+#include "control/ShowerStream.hh"
+#include "control/ShowerStore.hh"
 #include "globals.hh"
 
+// read-ahead cache used while decoding ParticlesTree
+#define PARTICLES_CACHE_SIZE (32 * 1024 * 1024)
+
 namespace nevod {
 
 struct DataFile {
   G4String data_dir_name;
+  G4String relative_dir_name;  // data_dir_name relative to the canonical input directory
   G4String dataset_name;
   G4int event_num;
+  G4String extension = ".root";
+  Long64_t particle_num = 0;
 
   DataFile(G4String data_dir_name, G4String dataset_name, G4int event_num);
 
   ~DataFile() = default;
 
+  // parses <data_dir_name>/<dataset_name>_<event_num><extension>
+  static DataFile FromPath(const fs::path& path);
+
+  // true when the file name ends with the _<event_num> suffix FromPath expects
+  static G4bool HasEventNumber(const fs::path& path);
+
   G4String GetFileName();
+
+  // file name without extension, same for the ROOT and the native copy
+  G4String GetKey() const;
+
+  // name of the file in the checkpoints, relative to the input directory, so the same file has the
+  // same key however input_file_path is spelled or wherever the directory is mounted
+  G4String GetUnitKey() const;
+
+  G4bool operator<(const DataFile& other) const;
+  G4bool operator==(const DataFile& other) const;
 };
 
 class InputManager {
   G4int files_num_ = 0;
   G4int thread_num_ = 0;
+  G4int discovery_thread_num_ = 0;
+  G4int lease_size_ = 1;
   Communicator* communicator_ = nullptr;
   size_t offset_ = 0;
 
@@ -36,22 +75,80 @@ class InputManager {
 
   std::vector<DataFile> files_;
 
-  G4int current_file_id;
+  // leases files to the threads reading them (I/O threads, or workers without prefetch)
+  FileScheduler scheduler_;
+
+  // files that failed to decode are dropped, their events leave the run total
+  std::atomic<G4int> event_num_{0};
+  std::atomic<size_t> unit_num_{0};  // (file, epoch) units left to simulate
+  std::atomic<G4int> failed_file_num_{0};
+  std::atomic<G4bool> input_error_{false};  // nothing readable is left
 
   G4Mutex mutex_ = G4MUTEX_INITIALIZER;
 
+  // prefetch of decoded showers (filled by I/O threads, drained by workers)
+  G4int prefetch_depth_ = 0;
+  G4int io_thread_num_ = 0;
+  std::vector<std::thread> io_threads_;
+  std::deque<ShowerPtr> ready_showers_;
+  size_t decoding_showers_ = 0;
+  std::once_flag prefetch_started_;
+  G4bool stop_prefetch_ = false;
+  G4Mutex prefetch_mutex_ = G4MUTEX_INITIALIZER;
+  G4Condition shower_ready_;
+  G4Condition slot_free_;
+
+  // decoded showers shared by all threads
+  ShowerStore store_;
+
+  // chunks of large showers shared by all workers
+  ShowerSplitter splitter_;
+
+  // showers from a producer on the same node, replaces the input files when set
+  ShowerStream* stream_ = nullptr;
+  G4int stream_shower_num_ = 0;
+  G4bool input_ended_ = false;
+
+  void StartPrefetch();
+  void StopPrefetch();
+  void PrefetchLoop();
+  ShowerPtr LoadShower(DataFile& file);
+  ShowerPtr ReadNextShower();
+  G4int GetFileEventNumber(const DataFile& file, const G4int epoch_num) const;
+  void DropFile(size_t index, const std::string& error);
+
  public:
   InputManager(Communicator* communicator, size_t offset = 0);
 
-  ~InputManager() = default;
+  ~InputManager();
 
   void DetectFiles(std::string path);
 
   G4int GetFilesNumber();
 
+  // events needed to simulate every file for the given epochs, split showers take one event per chunk
+  G4int GetEventNumber(const G4int epoch_num);
+
+  // (file, epoch) units of the readable files, counted by GetEventNumber
+  size_t GetUnitNumber() const;
+
+  ShowerSplitter& GetSplitter();
+
   std::vector<DataFile> GetNextFiles(const G4int files_num);
 
   DataFile& GetNextFile();
+
+  // nullptr once the shower stream is closed or no readable file is left
+  ShowerPtr GetNextShower();
+
+  G4bool IsStreaming() const;
+
+  // the input ended because nothing could be read
+  G4bool HasInputError() const;
+
+  G4int GetFailedFileNumber() const;
+
+  static ShowerPtr ReadShower(DataFile& file);
 };
 
 }  // namespace nevod
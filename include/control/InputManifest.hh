@@ -0,0 +1,58 @@
+#ifndef INPUTMANIFEST_HH
+#define INPUTMANIFEST_HH
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "G4AutoLock.hh"
+#include "Rtypes.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "control/Logger.hh"
+#include "control/ShowerFile.hh"
+#include "globals.hh"
+
+namespace fs = std::filesystem;
+
+namespace nevod {
+
+struct ManifestEntry {
+  std::string path{};
+  std::uintmax_t size = 0;
+  Long64_t mtime = 0;
+  Long64_t entry_num = 0;     // entries in HeaderTree
+  Long64_t particle_num = 0;  // entries in ParticlesTree
+  Double_t total_energy = 0;  // in GeV
+  G4bool valid = false;
+};
+
+// Cached validation results of input files, stored next to the input directory
+class InputManifest {
+  std::string manifest_path_;
+  std::map<std::string, ManifestEntry> entries_;
+  G4bool changed_ = false;
+
+  G4Mutex mutex_ = G4MUTEX_INITIALIZER;
+
+ public:
+  InputManifest(const std::string& input_path);
+
+  ~InputManifest() = default;
+
+  void Load();
+  void Save();
+
+  // returns cached entry, or opens and validates the file if it changed since the last run (thread safe)
+  ManifestEntry Validate(const fs::path& file_path);
+
+  static ManifestEntry ReadEntry(const fs::path& file_path);
+
+  const std::string& GetPath() const;
+  size_t GetSize() const;
+};
+
+}  // namespace nevod
+
+#endif  // INPUTMANIFEST_HH
\ No newline at end of file
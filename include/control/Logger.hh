@@ -0,0 +1,146 @@
+#ifndef LOGGER_HH
+#define LOGGER_HH
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "G4AutoLock.hh"
+#include "G4Threading.hh"
+#include "control/EventQueue.hh"
+#include "globals.hh"
+
+// messages below this level are not compiled: 0 debug, 1 info, 2 warning, 3 error
+#ifndef NEVOD_LOG_LEVEL
+#define NEVOD_LOG_LEVEL 1
+#endif
+
+#define LOG_QUEUE_SIZE 1024
+#define LOG_MESSAGE_SIZE 256
+#define LOG_FILE_PREFIX "log_"
+
+// the message is a stream expression, LOG_INFO("Launched event " << id), and is only formatted when its level is on
+#define NEVOD_LOG(level, message)                                                        \
+  do {                                                                                   \
+    if (nevod::Logger::Instance().IsEnabled(level)) {                                    \
+      if (std::ostream* nevod_log_stream = nevod::Logger::Instance().BeginLine(level)) { \
+        *nevod_log_stream << message;                                                    \
+        nevod::Logger::Instance().EndLine();                                             \
+      }                                                                                  \
+    }                                                                                    \
+  } while (false)
+
+#if NEVOD_LOG_LEVEL <= 0
+#define LOG_DEBUG(message) NEVOD_LOG(nevod::LogLevel::DEBUG, message)
+#else
+#define LOG_DEBUG(message) \
+  do {                     \
+  } while (false)
+#endif
+
+#if NEVOD_LOG_LEVEL <= 1
+#define LOG_INFO(message) NEVOD_LOG(nevod::LogLevel::INFO, message)
+#else
+#define LOG_INFO(message) \
+  do {                    \
+  } while (false)
+#endif
+
+#if NEVOD_LOG_LEVEL <= 2
+#define LOG_WARNING(message) NEVOD_LOG(nevod::LogLevel::WARNING, message)
+#else
+#define LOG_WARNING(message) \
+  do {                       \
+  } while (false)
+#endif
+
+#define LOG_ERROR(message) NEVOD_LOG(nevod::LogLevel::ERROR, message)
+
+namespace fs = std::filesystem;
+
+namespace nevod {
+
+enum struct LogLevel { DEBUG = 0, INFO, WARNING, ERROR, OFF };
+
+struct LogRecord {
+  LogLevel level{LogLevel::INFO};
+  std::chrono::steady_clock::time_point time{};
+  char message[LOG_MESSAGE_SIZE]{};
+};
+
+// Formats straight into the message of a ring slot, longer messages are cut
+class LogBuffer : public std::streambuf {
+ public:
+  void Reset(char* begin, size_t size) { setp(begin, begin + size - 1); }
+  size_t GetSize() const { return pptr() - pbase(); }
+};
+
+// Messages of one thread, pushed only by it and popped by the flusher
+struct LogChannel {
+  G4int thread_id = -1;  // Geant4 worker id, -1 for the master and helper threads
+  size_t index = 0;      // registration order, names the files of non-worker threads
+  EventQueue<LogRecord> queue{LOG_QUEUE_SIZE};
+  std::atomic<size_t> dropped{0};
+
+  // line being formatted
+  LogBuffer buffer;
+  std::ostream stream{&buffer};
+  LogRecord* record = nullptr;
+  size_t ticket = 0;
+
+  std::ofstream file;  // owned by the flusher
+
+  std::string GetName() const;
+};
+
+// Leveled logging for the event loop. A thread formats its message into its own lock-free ring
+// and goes on, a background thread writes the rings to one file per thread in the log directory,
+// or to G4cout when the logs are not saved. A full ring drops the message instead of waiting.
+class Logger {
+  std::atomic<G4int> level_{static_cast<G4int>(LogLevel::OFF)};
+  G4bool save_ = false;
+  fs::path dir_{};
+  std::chrono::steady_clock::time_point start_time_ = std::chrono::steady_clock::now();
+
+  std::vector<std::unique_ptr<LogChannel>> channels_;
+  G4Mutex mutex_ = G4MUTEX_INITIALIZER;
+
+  std::atomic<G4bool> stop_{false};
+  std::thread thread_;
+
+  Logger() = default;
+
+  LogChannel& GetChannel();
+  size_t Drain(LogChannel& channel);
+  void Loop();
+
+ public:
+  static Logger& Instance();
+
+  ~Logger();
+
+  // messages below the level are skipped at run time, the files go to dir when save is set
+  void Start(LogLevel level, G4bool save, const std::string& dir);
+  // writes the pending messages and stops the flusher, later messages are skipped
+  void Stop();
+
+  G4bool IsEnabled(LogLevel level) const { return static_cast<G4int>(level) >= level_.load(std::memory_order_relaxed); }
+
+  // stream of a claimed slot, nullptr when the ring of the calling thread is full
+  std::ostream* BeginLine(LogLevel level);
+  void EndLine();
+
+  static const char* GetLevelName(LogLevel level);
+  static LogLevel ParseLevel(const std::string& name);
+};
+
+}  // namespace nevod
+
+#endif  // LOGGER_HH
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef OUTPUTBACKEND_HH
+#define OUTPUTBACKEND_HH
+
+#include <functional>
+#include <memory>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "control/EventData.hh"
+#include "globals.hh"
+
+#ifdef NEVOD_WITH_RNTUPLE
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+#endif
+
+namespace nevod {
+
+enum struct OutputFormat {
+  TTREE,
+  RNTUPLE  // needs a build with WITH_RNTUPLE
+};
+
+// Data sets of the output file, filled from the event data of the writer thread.
+// RunHeaderTree and EventTree keep their names and columns in every format.
+class OutputBackend {
+ public:
+  virtual ~OutputBackend() = default;
+
+  virtual const char* GetName() const = 0;
+
+  virtual void FillHeader() = 0;
+  virtual void FillEvent(G4int epoch) = 0;
+
+  // saves what is filled so far, true when the file is readable up to here after a crash
+  virtual G4bool Save() = 0;
+
+  // finishes the data sets, the file itself is written and closed by the caller
+  virtual void Close() = 0;
+};
+
+class TTreeBackend : public OutputBackend {
+  TTree* run_header_tree_ = nullptr;
+  TTree* event_tree_ = nullptr;
+  G4int epoch_ = 0;
+
+ public:
+  // trees are created in the current directory and belong to the file
+  TTreeBackend(EventData& data, const OutputPolicy& policy);
+
+  ~TTreeBackend() override = default;
+
+  const char* GetName() const override { return "ttree"; }
+
+  void FillHeader() override;
+  void FillEvent(G4int epoch) override;
+  G4bool Save() override;
+  void Close() override;
+};
+
+#ifdef NEVOD_WITH_RNTUPLE
+class RNTupleBackend : public OutputBackend {
+  std::unique_ptr<ROOT::Experimental::RNTupleWriter> run_header_writer_;
+  std::unique_ptr<ROOT::Experimental::RNTupleWriter> event_writer_;
+  std::shared_ptr<G4int> epoch_;
+  std::function<void()> copy_header_, copy_event_;
+
+ public:
+  RNTupleBackend(TFile& file, EventData& data, const OutputPolicy& policy);
+
+  ~RNTupleBackend() override = default;
+
+  const char* GetName() const override { return "rntuple"; }
+
+  void FillHeader() override;
+  void FillEvent(G4int epoch) override;
+  // clusters are written, but the footer making them readable only comes with Close
+  G4bool Save() override;
+  void Close() override;
+};
+#endif
+
+std::unique_ptr<OutputBackend> MakeOutputBackend(OutputFormat format, TFile& file, EventData& data, const OutputPolicy& policy);
+
+}  // namespace nevod
+
+#endif  // OUTPUTBACKEND_HH
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef OUTPUTMERGER_HH
+#define OUTPUTMERGER_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <queue>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "G4AutoLock.hh"
+#include "TFile.h"
+#include "TFileMerger.h"
+#include "TTree.h"
+#include "control/Logger.hh"
+#include "globals.hh"
+
+#define OUTPUT_PREFIX "output"
+#define MERGED_OUTPUT_NAME "merged.root"
+
+namespace fs = std::filesystem;
+
+namespace nevod {
+
+struct OutputMergerParams {
+  std::string output_dir;
+  G4int thread_num = 1;
+  G4bool sort = false;              // order events by (input file, epoch, event id)
+  G4bool delete_inputs = false;     // remove the shards once they are merged
+  G4int compression_settings = -1;  // same as the shards, so baskets are copied without recompression
+};
+
+// Merges the output shards of the run into <output_dir>/merged.root. Groups of shards are
+// merged side by side into partial files, which are then concatenated basket by basket, so
+// the unsorted merge is bound by the disk. Sorting reorders the entries of every shard in
+// its own thread, and a k-way merge of the sorted shards replaces the concatenation.
+class OutputMerger {
+  OutputMergerParams params_;
+  std::vector<fs::path> inputs_;
+
+  // sort key of an event tree entry, sources are numbered in name order
+  struct EventKey {
+    Int_t source = 0;
+    Int_t epoch = 0;
+    Long64_t event_id = 0;
+    Long64_t entry = 0;
+
+    G4bool operator<(const EventKey& other) const {
+      return std::tie(source, epoch, event_id, entry) < std::tie(other.source, other.epoch, other.event_id, other.entry);
+    }
+  };
+
+  // keys of every entry of the trees in entry order, with one source numbering for all of them
+  static std::vector<std::vector<EventKey>> ReadKeys(const std::vector<TTree*>& event_trees);
+
+  static void FastMerge(const std::vector<fs::path>& inputs, const fs::path& output, G4int compression_settings);
+  static void SortedCopy(const fs::path& input, const fs::path& output, G4int compression_settings);
+  static void SortedMerge(const std::vector<fs::path>& inputs, const fs::path& output, G4int compression_settings);
+
+ public:
+  OutputMerger(const OutputMergerParams& params);
+
+  ~OutputMerger() = default;
+
+  // shards in writing order, an earlier merged file joins them when the shards are deleted after merging
+  size_t FindInputs();
+
+  void Merge();
+
+  // shard of an output file name (output.root is 0, output_part<N>.root is N), -1 for other files
+  static G4int ParseShard(const std::string& name);
+
+  // removes the shards and the merged file of an earlier run, returns their number
+  static size_t RemoveOutputs(const std::string& output_dir);
+};
+
+}  // namespace nevod
+
+#endif  // OUTPUTMERGER_HH
\ No newline at end of file
@@ -0,0 +1,121 @@
+#ifndef OUTPUTWRITER_HH
+#define OUTPUTWRITER_HH
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "control/Checkpoint.hh"
+#include "control/EventData.hh"
+#include "control/EventQueue.hh"
+#include "control/Logger.hh"
+#include "control/OutputBackend.hh"
+#include "globals.hh"
+
+namespace nevod {
+
+// Copy of the event response handed from a worker to the writer thread
+struct EventRecord {
+  G4bool header = false;  // fill the header tree with this shower
+  G4bool event = false;   // fill the event tree
+  G4int epoch = 0;
+
+  ShowerPtr shower;
+  ULong_t filtered_species{}, filtered_energy{}, filtered_time{};
+
+  Double_t theta{}, phi{};
+  Double_t theta_rec{}, phi_rec{};
+  Double_t energy_dep{};
+  ULong_t particle_count{};
+  Double_t track_length{};
+  ULong_t muon_count{};
+  Double_t energy_start{}, energy_end{};
+  Long64_t duration{};
+  Double_t core_x{}, core_y{}, rotation{};
+  ULong_t culled_count{};
+  Double_t culled_energy{};
+
+  // dense arrays, or their non-zero channels in the sparse mode
+  G4bool sparse = false;
+  std::vector<Double_t> muon_decor, muon_decor_w, edep_count_sct, amplitude_qsm;
+  SparseArray sparse_decor, sparse_decor_w, sparse_sct, sparse_qsm;
+
+  void Capture(const EventData& data, const EventLayout& layout);
+  // the shower is bound by the writer, not here
+  void Restore(EventData& data) const;
+};
+
+struct OutputWriterParams {
+  std::string output_path;      // ROOT file
+  std::string checkpoint_path;  // finished units
+  EventLayout layout{};
+  size_t queue_size = 256;
+  G4int flush_interval = 10;        // events between flushes of the file, 0 flushes only on checkpoints
+  G4int checkpoint_interval = 100;  // events between saves of the trees and the checkpoint
+  G4int epoch_num = 0;              // epochs of every file, sizes the exactly-once check
+  size_t binding_num = 8;           // mapped showers whose output columns are kept, about one per worker
+  OutputFormat format{OutputFormat::TTREE};
+  OutputPolicy policy{};
+};
+
+// Owns the output file of the run. Workers push their events through a bounded lock-free
+// queue and the writer thread fills, compresses and saves the trees, so the tracking
+// threads never touch the file. A full queue makes the workers wait for the writer.
+class OutputWriter {
+  OutputWriterParams params_;
+  EventQueue<EventRecord> queue_;
+
+  std::thread thread_;
+  std::atomic<G4bool> stop_{false};
+
+  // statistics, printed on Close
+  std::atomic<size_t> stall_num_{0};
+  size_t written_num_ = 0;
+
+  // records of all threads interleave, so the columns of each mapped shower are copied once
+  // and kept here instead of being copied again whenever the shower changes
+  struct Binding {
+    Particles columns;
+    size_t last_use = 0;
+  };
+  std::map<ShowerPtr, Binding> bindings_;
+  size_t binding_use_ = 0;
+
+  // (file, epoch) units in the output, owned by the writer thread
+  std::unordered_map<std::string, std::vector<uint8_t>> written_units_;
+  size_t unit_num_ = 0;
+  size_t duplicate_num_ = 0;
+
+  void Loop();
+  void WriteChannelMap(const EventData& data);
+
+  // false when the unit is already in the output
+  G4bool MarkWritten(const std::string& source, G4int epoch);
+
+  // binds the shower to the output, reusing its columns when they were copied before
+  void BindShower(EventData& output, const ShowerPtr& shower);
+
+ public:
+  OutputWriter(const OutputWriterParams& params);
+
+  ~OutputWriter();
+
+  // thread safe, blocks while the queue is full
+  void Push(const EventData& data, G4int epoch, G4bool header, G4bool event);
+
+  // writes everything pushed so far and closes the file, call once the workers are done
+  void Close();
+
+  // distinct (file, epoch) units written and the repeated ones left out, valid after Close
+  size_t GetUnitNumber() const;
+  size_t GetDuplicateNumber() const;
+};
+
+}  // namespace nevod
+
+#endif  // OUTPUTWRITER_HH
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef SHOWERFILE_HH
+#define SHOWERFILE_HH
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "control/EventData.hh"
+#include "globals.hh"
+
+#define SHOWER_FILE_MAGIC "NEVODSHW"
+#define SHOWER_FILE_VERSION 1
+#define SHOWER_FILE_EXTENSION ".nsh"
+
+namespace fs = std::filesystem;
+
+namespace nevod {
+
+// Native shower file: this header followed by PARTICLE_COLUMN_NUM columns of particle_count 8-byte values
+// (particle_id, particle_num, x, y, z, px, py, pz, energy), host byte order, starting at header_size
+struct ShowerFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t particle_count;
+  uint64_t event_id;
+  uint64_t primary_particle_id;
+  uint64_t particle_amount;
+  double theta, phi;  // in degrees
+};
+
+static_assert(sizeof(ShowerFileHeader) == 64, "shower file header must stay 64 bytes");
+static_assert(sizeof(ULong_t) == sizeof(uint64_t) && sizeof(Double_t) == sizeof(double), "columns are mapped as is");
+
+// header and columns of the shower in the file layout
+void WriteShower(std::ostream& stream, const Shower& shower);
+
+void WriteShowerFile(const std::string& path, const Shower& shower);
+
+// size of the shower in the file layout
+size_t GetShowerFileSize(const Shower& shower);
+
+// throws when the header is not a supported shower header, source names it in the message
+void CheckShowerHeader(const ShowerFileHeader& header, const std::string& source);
+
+// maps the file read-only, the returned shower views the mapped pages and keeps them mapped;
+// source names the shower in the checkpoints, the path without extension when empty
+ShowerPtr MapShowerFile(const std::string& path, const std::string& source = "");
+
+}  // namespace nevod
+
+#endif  // SHOWERFILE_HH
\ No newline at end of file
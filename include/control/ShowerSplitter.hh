@@ -0,0 +1,75 @@
+#ifndef SHOWERSPLITTER_HH
+#define SHOWERSPLITTER_HH
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "G4AutoLock.hh"
+#include "control/EventData.hh"
+#include "globals.hh"
+
+namespace nevod {
+
+// Large shower whose epochs are simulated in chunks by all threads.
+// Every chunk is a separate event, the responses of one epoch are reduced back into a single event.
+class SplitShower {
+  struct Partial {
+    EventData response;
+    G4int chunk_done = 0;
+  };
+
+  std::map<G4int, Partial> partials_;  // epochs with chunks still running
+  G4Mutex mutex_ = G4MUTEX_INITIALIZER;
+
+ public:
+  ShowerPtr shower;
+  std::vector<uint8_t> launch;  // primaries passing the physics cuts, same for every epoch
+  std::vector<size_t> bounds;   // chunk i covers particles [bounds[i], bounds[i + 1])
+  std::vector<G4int> epochs;  // epochs still to simulate
+  G4int chunk_num = 0;
+  size_t next_unit = 0;  // guarded by the splitter
+
+  // header statistics of the shower
+  ULong_t filtered_species{}, filtered_energy{}, filtered_time{};
+
+  SplitShower(ShowerPtr shower, const std::vector<uint8_t>& launch, const std::vector<G4int>& epochs, G4int chunk_num);
+
+  ~SplitShower() = default;
+
+  // adds the chunk response, returns true for the last chunk of the epoch with the whole response in data
+  G4bool Reduce(G4int epoch, EventData& data);
+};
+
+struct ShowerChunk {
+  std::shared_ptr<SplitShower> split;
+  G4int epoch = 0;
+  G4int chunk = 0;
+  size_t begin = 0, end = 0;
+};
+
+// Queue of split showers, chunks are handed out in posting order
+class ShowerSplitter {
+  size_t threshold_ = 0;
+  G4int chunk_num_ = 1;
+
+  std::deque<std::shared_ptr<SplitShower>> active_;
+  G4Mutex mutex_ = G4MUTEX_INITIALIZER;
+
+ public:
+  ShowerSplitter(size_t threshold = 0, G4int chunk_num = 1);
+
+  ~ShowerSplitter() = default;
+
+  // number of events for one epoch of a shower (1 when it is not split)
+  G4int GetChunkNumber(size_t particle_num) const;
+
+  void Post(std::shared_ptr<SplitShower> split);
+
+  G4bool Next(ShowerChunk& chunk);
+};
+
+}  // namespace nevod
+
+#endif  // SHOWERSPLITTER_HH
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef SHOWERSTORE_HH
+#define SHOWERSTORE_HH
+
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+
+#include "G4AutoLock.hh"
+#include "control/EventData.hh"
+#include "control/Logger.hh"
+#include "globals.hh"
+
+namespace nevod {
+
+struct DataFile;
+
+// Process-wide cache of decoded showers with LRU eviction under a memory budget.
+// Showers are immutable, so threads holding a pointer keep it alive after eviction.
+// The scheduler hands every file out once per run, so hits come only from files read again.
+class ShowerStore {
+  struct Entry {
+    std::shared_future<ShowerPtr> shower;
+    size_t bytes = 0;
+    std::list<std::string>::iterator lru_position;
+  };
+
+  size_t budget_bytes_ = 0;
+  size_t used_bytes_ = 0;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+
+  std::map<std::string, Entry> entries_;
+  std::list<std::string> lru_;  // most recently used first
+
+  G4Mutex mutex_ = G4MUTEX_INITIALIZER;
+
+  void Evict();
+
+ public:
+  ShowerStore(size_t budget_bytes = 0);
+
+  ~ShowerStore() = default;
+
+  // returns cached shower or decodes it with the loader, concurrent requests for one file decode it once
+  ShowerPtr Get(DataFile& file, const std::function<ShowerPtr(DataFile&)>& loader);
+
+  void PrintStatistics();
+
+  static size_t GetShowerBytes(const Shower& shower);
+};
+
+}  // namespace nevod
+
+#endif  // SHOWERSTORE_HH
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef SHOWERSTREAM_HH
+#define SHOWERSTREAM_HH
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "G4AutoLock.hh"
+#include "control/EventData.hh"
+#include "control/Logger.hh"
+#include "control/ShowerFile.hh"
+#include "globals.hh"
+
+namespace nevod {
+
+// Showers read from a FIFO or a Unix stream socket. Every record is a uint64_t byte length
+// followed by the shower in the native file layout (ShowerFileHeader and the particle columns),
+// host byte order. The producer ends the run by closing its end of the stream.
+class ShowerStream {
+  std::string path_;
+  int descriptor_ = -1;
+  G4bool closed_ = false;
+  size_t shower_num_ = 0;
+
+  G4Mutex mutex_ = G4MUTEX_INITIALIZER;
+
+  void Open();
+
+  // false when the stream ends before the first byte
+  G4bool ReadExact(void* buffer, size_t size);
+
+ public:
+  ShowerStream(const std::string& path);
+
+  ~ShowerStream();
+
+  // blocks until the next shower arrives, nullptr after the producer closed the stream
+  ShowerPtr Next();
+
+  size_t GetShowerNumber();
+};
+
+}  // namespace nevod
+
+#endif  // SHOWERSTREAM_HH
\ No newline at end of file
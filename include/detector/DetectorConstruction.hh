@@ -30,6 +30,20 @@
 
 namespace nevod {
 
+// the geometry places a tube on each face of a module and one SCT side above and below the pool
+constexpr G4bool IsPlaceable(const CWDLayout& layout) { return layout.tube_num <= PMT_PER_QSM; }
+constexpr G4bool IsPlaceable(const SCTLayout& layout) { return layout.side_num <= 2; }
+
+template <typename Layout, size_t N>
+constexpr G4bool IsPlaceable(const Layout (&layouts)[N]) {
+  for (const auto& layout: layouts)
+    if (!IsPlaceable(layout)) return false;
+  return true;
+}
+
+static_assert(IsPlaceable(CWD_LAYOUTS), "CWD layout does not fit the module geometry");
+static_assert(IsPlaceable(SCT_LAYOUTS), "SCT layout does not fit the detector geometry");
+
 class DetectorConstruction : public G4VUserDetectorConstruction {
  public:
   DetectorConstruction();
@@ -61,6 +75,9 @@ class DetectorConstruction : public G4VUserDetectorConstruction {
   // NEVOD-EAS
   void BuildEAS();
 
+  // envelope of placed boxes used to cull primaries outside the acceptance
+  void SendAcceptanceBox(const std::vector<G4VPhysicalVolume*>& volumes, const std::vector<G4Box*>& boxes);
+
   Communicator* communicator_ = nullptr;
 
   // option to activate checking of volumes overlaps
@@ -77,9 +94,7 @@ class DetectorConstruction : public G4VUserDetectorConstruction {
   ConstructionFlags construction_flags_;
 
   // CWD
-  G4int cwd_plane_number_;
-  std::vector<G4int> stride_config_;
-  std::vector<G4int> qsm_config_;
+  CWDLayout cwd_layout_;
 
   G4Tubs* air_tube_ = nullptr;
   vector4d<G4LogicalVolume*> air_tube_log_;
@@ -90,8 +105,7 @@ class DetectorConstruction : public G4VUserDetectorConstruction {
   vector4d<G4VPhysicalVolume*> photocathode_phys_;
 
   // SCT (2 for outer and inner)
-  std::pair<G4int, G4int> sct_plane_number_;
-  std::pair<G4int, G4int> sct_counter_number_;
+  SCTLayout sct_layout_;
   std::vector<std::pair<G4Box*, G4Box*>> sct_counter_box_;
   std::vector<std::pair<G4LogicalVolume*, G4LogicalVolume*>> sct_counter_log_;
   std::vector<std::pair<G4VPhysicalVolume*, G4VPhysicalVolume*>> sct_counter_phys_;
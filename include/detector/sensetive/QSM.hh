@@ -25,7 +25,6 @@ class PhotocathodeSensetiveDetector : public G4VSensitiveDetector {
   Communicator* communicator_;
   G4double minimum_energy_ = 0;
   G4double maximum_energy_{};
-  G4int total_pmt_count_{};
 
  public:
   PhotocathodeSensetiveDetector(G4String name, Communicator* communicator);
@@ -11,7 +11,6 @@ namespace nevod {
 
 class SCTSensetiveDetector : public G4VSensitiveDetector {
   Communicator* communicator_;
-  G4int total_sct_count_;
 
  public:
   SCTSensetiveDetector(G4String name, Communicator* communicator);
@@ -54,9 +54,11 @@ int main(int argc, char** argv) {
   run_manager->SetUserInitialization(physics_list);
 
   nevod::InputManager* input_manager = new nevod::InputManager(communicator, params.initial_offset);
-  input_manager->DetectFiles(params.input_path);
+  if (!input_manager->IsStreaming()) {
+    input_manager->DetectFiles(params.input_path);
 
-  if (input_manager->GetFilesNumber() == 0) throw std::invalid_argument("No files found in the input directory");
+    if (input_manager->GetFilesNumber() == 0) throw std::invalid_argument("No files found in the input directory");
+  }
 
   run_manager->SetUserInitialization(new nevod::ActionInitialization(communicator, input_manager));
 
@@ -77,11 +79,15 @@ int main(int argc, char** argv) {
 #endif
     run_manager->Initialize();
 
-    G4int total_events_count = params.epoch_num * input_manager->GetFilesNumber();
+    G4int total_events_count = input_manager->GetEventNumber(params.epoch_num);
 
     communicator->SetTotalEventCount(total_events_count);
     G4cout << "Events to simulate: " << total_events_count << G4endl;
-    run_manager->BeamOn(total_events_count);
+
+    // the run ends when every worker found the input used up and aborted, not at this count; the spare
+    // event per worker is the one it aborts, so no unit is left out (the stream has no such end, its count is exact)
+    G4int spare_events_count = input_manager->IsStreaming() ? 0 : std::max(params.thread_num, 1);
+    run_manager->BeamOn(total_events_count + spare_events_count);
   }
 
   // // Initialize G4 kernel
@@ -116,13 +122,26 @@ int main(int argc, char** argv) {
   //   }
   // #endif
 
+  communicator->CloseOutput();
+
+  // the run stopped early, the output misses the events of unreadable files
+  G4bool run_failed = input_manager->HasInputError();
+  if (input_manager->GetFailedFileNumber() > 0) G4cerr << input_manager->GetFailedFileNumber() << " input files could not be read" << G4endl;
+
+  // every (file, epoch) unit of the readable files is written exactly once, repeated ones are left out by the writer
+  if (!params.use_ui && !input_manager->IsStreaming() && communicator->GetWrittenUnitNumber() != input_manager->GetUnitNumber()) {
+    G4cerr << "Output holds " << communicator->GetWrittenUnitNumber() << " of " << input_manager->GetUnitNumber() << " (file, epoch) units" << G4endl;
+    run_failed = true;
+  }
+
   communicator->MergeOutputFiles();
   communicator->PrintEndMessage();
 
   delete vis_manager;
-  delete communicator;
+  // the input manager reports its statistics through the logger the communicator stops
   delete input_manager;
+  delete communicator;
   delete run_manager;
 
-  return 0;
+  return run_failed ? 1 : 0;
 }
\ No newline at end of file
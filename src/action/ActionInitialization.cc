@@ -14,7 +14,7 @@ void ActionInitialization::Build() const {
   auto generator = new PrimaryGeneratorAction(communicator_, input_manager_);
   SetUserAction(generator);
 
-  auto run_action = new RunAction(communicator_);
+  auto run_action = new RunAction(communicator_, generator);
   SetUserAction(run_action);
 
   auto event_action = new EventAction(run_action, communicator_);
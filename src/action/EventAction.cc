@@ -14,39 +14,42 @@ double normalRandom(double a, double sigma) {
 }
 
 EventAction::EventAction(RunAction* run_action, Communicator* communicator): G4UserEventAction(), communicator_(communicator) {
-  G4int thread_id = G4Threading::G4GetThreadId();
-
-  std::string output_file_name = communicator_->GetSimulationParams().output_dir_path + "/output_thread_" + std::to_string(thread_id) + ".root";
-  output_file_ = new TFile(output_file_name.c_str(), "RECREATE");
-
+  // buffers are sized here once and reused by every event of this thread
+  communicator_->AllocateEventData();
   event_data_ = communicator_->GetEventData();
 
-  run_header_tree_ = new TTree("RunHeaderTree", "run level data");
-  event_data_->ConnectHeaderTree(run_header_tree_);
-
-  event_tree_ = new TTree("EventTree", "event level data");
-  event_tree_->Branch("Epoch", &current_epoch_, "Epoch/I");
-  event_data_->ConnectEventTree(event_tree_);
+  output_writer_ = communicator_->GetOutputWriter();
 }
 
-EventAction::~EventAction() {
-  output_file_->Write();
-  output_file_->Close();
-  delete output_file_;
-}
+EventAction::~EventAction() = default;
 
 void EventAction::BeginOfEventAction(const G4Event*) {}
 
 void EventAction::EndOfEventAction(const G4Event*) {
   auto current_time = std::chrono::steady_clock::now();
 
-  if (!header_processed_) {
-    run_header_tree_->Fill();
-    header_processed_ = true;
+  // nothing was launched, the input ended before this event. Events aborted by the time limit are kept.
+  if (event_data_->input_ended) {
+    event_data_->input_ended = false;
+    event_data_->Clear(false);
+    return;
   }
 
+  // one header entry per shower, it keeps the filter statistics of that shower
+  G4bool header = event_data_->header_pending;
+  event_data_->header_pending = false;
+
   event_data_->duration = (current_time - event_data_->start_time).count();
 
+  // chunks of a split shower are written once, by the thread finishing the last one of the epoch
+  if (event_data_->split && !event_data_->split->Reduce(event_data_->split_epoch, *event_data_)) {
+    if (header) output_writer_->Push(*event_data_, 0, true, false);
+    event_data_->split = nullptr;
+    event_data_->Clear(false);
+    return;
+  }
+  event_data_->split = nullptr;
+
   if (event_data_->muon_nevod.first.detected_copy_num >= 0 && event_data_->muon_nevod.second.detected_copy_num >= 0) {
     event_data_->muon_count = 1;
     event_data_->track_length = std::hypot(
@@ -61,29 +64,28 @@ void EventAction::EndOfEventAction(const G4Event*) {
   G4double amplitude, q;
 
   for (size_t i = 0; i < event_data_->photoelectron_num.size(); ++i) {
-    auto id = communicator_->GetQSMId(i);
-
     if (event_data_->photoelectron_num[i] > 0) {
+      auto id = PMTChannel::Decode(i);
       amplitude = 0;
-      for (G4int i = 0; i < event_data_->photoelectron_num[i]; i++) {
+      for (G4int j = 0; j < event_data_->photoelectron_num[i]; j++) {
         q = -4. * log(1. - G4UniformRand());                                  // G4UniformRand != 1.
         if (event_data_->photoelectron_num[i] > 1) q = normalRandom(q, 2.8);  // delta_1e*A_1e = 0.7*4.0 = 2.8
         amplitude += q;
       }
       if (amplitude < 1.0) amplitude = 1.0;
 
-      event_data_->amplitude_qsm[id.plane][id.stripe][id.module][id.tube] = amplitude;
+      event_data_->amplitude_qsm(id.plane, id.stripe, id.module, id.tube) = amplitude;
     }
   }
 
-  current_epoch_ = communicator_->GetCurrentEpoch();
-
-  event_tree_->Fill();
-  output_file_->Flush();
+  // compression and file writes happen on the writer thread
+  output_writer_->Push(*event_data_, communicator_->GetCurrentEpoch(), header, true);
 
-  G4cout << event_data_ << G4endl;
+  LOG_DEBUG("Finished event " << event_data_->event_id << ": " << event_data_->particle_count << " particles, " << event_data_->energy_dep
+                               << " energy deposit");
 
-  event_data_->Clear();
+  // shower header and particles stay for the remaining epochs
+  event_data_->Clear(false);
 }
 
 }  // namespace nevod
\ No newline at end of file
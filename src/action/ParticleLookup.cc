@@ -0,0 +1,57 @@
+#include "action/ParticleLookup.hh"
+
+namespace nevod {
+
+void ParticleLookup::Build() {
+  particle_table_ = G4ParticleTable::GetParticleTable();
+
+  table_.assign(2 * PARTICLE_LOOKUP_RANGE, nullptr);
+  other_.clear();
+  unknown_.clear();
+  zero_momentum_ = 0;
+
+  auto iterator = particle_table_->GetIterator();
+  iterator->reset();
+  while ((*iterator)()) {
+    G4ParticleDefinition* particle = iterator->value();
+    G4int pdg = particle->GetPDGEncoding();
+    if (pdg == 0) continue;
+
+    if (pdg >= -PARTICLE_LOOKUP_RANGE && pdg < PARTICLE_LOOKUP_RANGE)
+      table_[pdg + PARTICLE_LOOKUP_RANGE] = particle;
+    else
+      other_[pdg] = particle;
+  }
+}
+
+G4ParticleDefinition* ParticleLookup::Find(const ULong_t particle_id) {
+  // PDG codes are stored unsigned in the input, antiparticles wrap around
+  G4int pdg = static_cast<G4int>(particle_id);
+
+  G4ParticleDefinition* particle = nullptr;
+  if (pdg >= -PARTICLE_LOOKUP_RANGE && pdg < PARTICLE_LOOKUP_RANGE) {
+    particle = table_[pdg + PARTICLE_LOOKUP_RANGE];
+  } else {
+    // ions may be created during the run, so codes outside the array are asked for once
+    auto found = other_.find(pdg);
+    if (found == other_.end()) found = other_.emplace(pdg, particle_table_->FindParticle(pdg)).first;
+    particle = found->second;
+  }
+
+  if (particle == nullptr) unknown_[pdg]++;
+
+  return particle;
+}
+
+void ParticleLookup::CountZeroMomentum() { zero_momentum_++; }
+
+void ParticleLookup::PrintSummary() const {
+  if (zero_momentum_ > 0) LOG_WARNING("Skipped " << zero_momentum_ << " primaries with zero momentum");
+  if (unknown_.empty()) return;
+
+  // one message per code, a single one would be cut at the message size
+  for (const auto& [pdg, count]: unknown_)
+    LOG_WARNING("Skipped " << count << " primaries with unknown PDG code " << pdg);
+}
+
+}  // namespace nevod
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "action/PrimaryFilter.hh"
+
+namespace nevod {
+
+AcceptanceFilter::AcceptanceFilter(const std::vector<AcceptanceBox>& boxes, const G4double margin) {
+  for (const auto& box: boxes) {
+    min_x_.push_back(box.center.x() - box.half_size.x() - margin);
+    min_y_.push_back(box.center.y() - box.half_size.y() - margin);
+    min_z_.push_back(box.center.z() - box.half_size.z() - margin);
+    max_x_.push_back(box.center.x() + box.half_size.x() + margin);
+    max_y_.push_back(box.center.y() + box.half_size.y() + margin);
+    max_z_.push_back(box.center.z() + box.half_size.z() + margin);
+  }
+}
+
+void AcceptanceFilter::Apply(const ParticleView& particles, const G4ThreeVector& shift, std::vector<uint8_t>& accepted) const {
+  const size_t size = particles.size;
+  accepted.assign(size, 0);
+
+  // without envelopes nothing can be proven useless
+  if (min_x_.empty()) {
+    accepted.assign(size, 1);
+    return;
+  }
+
+  const Double_t* x = particles.x;
+  const Double_t* y = particles.y;
+  const Double_t* z = particles.z;
+  const Double_t* px = particles.px;
+  const Double_t* py = particles.py;
+  const Double_t* pz = particles.pz;
+  uint8_t* hit = accepted.data();
+
+  const G4double shift_x = shift.x(), shift_y = shift.y(), shift_z = shift.z();
+
+  constexpr G4double infinity = std::numeric_limits<G4double>::infinity();
+
+  // interval of the axis parameter inside the slab [min, max], narrowed into [t_near, t_far]
+  auto clip = [](G4double origin, G4double momentum, G4double min, G4double max, G4double& t_near, G4double& t_far) {
+    // an axis parallel to the slab is inside along its whole length when the origin is, and never otherwise;
+    // selects instead of branches keep the loop vectorizable, and 0 * inf never turns into NaN
+    const G4bool parallel = momentum == 0;
+    const G4bool inside = origin >= min && origin <= max;
+    const G4double inverse = parallel ? 0.0 : 1.0 / momentum;
+    const G4double t1 = (min - origin) * inverse, t2 = (max - origin) * inverse;
+
+    t_near = std::max(t_near, parallel ? (inside ? -infinity : infinity) : std::min(t1, t2));
+    t_far = std::min(t_far, parallel ? (inside ? infinity : -infinity) : std::max(t1, t2));
+  };
+
+  for (size_t box = 0; box < min_x_.size(); ++box) {
+    const G4double min_x = min_x_[box], min_y = min_y_[box], min_z = min_z_[box];
+    const G4double max_x = max_x_[box], max_y = max_y_[box], max_z = max_z_[box];
+
+    for (size_t i = 0; i < size; ++i) {
+      const G4double origin_x = x[i] - shift_x, origin_y = y[i] - shift_y, origin_z = z[i] - shift_z;
+
+      // only the part of the axis in front of the particle counts
+      G4double t_near = 0.0, t_far = infinity;
+      clip(origin_x, px[i], min_x, max_x, t_near, t_far);
+      clip(origin_y, py[i], min_y, max_y, t_near, t_far);
+      clip(origin_z, pz[i], min_z, max_z, t_near, t_far);
+
+      hit[i] |= static_cast<uint8_t>(t_far >= t_near);
+    }
+  }
+}
+
+size_t AcceptanceFilter::GetBoxNumber() const { return min_x_.size(); }
+
+PhysicsFilter::PhysicsFilter(const PrimaryFilterParams& params): params_(params) {
+  enabled_ = params_.default_energy_threshold > 0 || !params_.energy_thresholds.empty() || !params_.species_whitelist.empty() ||
+             !params_.species_blacklist.empty() || params_.use_time_window;
+}
+
+FilterCounts PhysicsFilter::Apply(const ParticleView& particles, const G4double theta, const G4double phi, std::vector<uint8_t>& kept) {
+  const size_t size = particles.size;
+  kept.assign(size, 1);
+
+  FilterCounts counts;
+  if (!enabled_) return counts;
+
+  species_ok_.assign(size, 1);
+  energy_ok_.assign(size, 1);
+  time_ok_.assign(size, 1);
+
+  const ULong_t* id = particles.particle_id;
+  const Double_t* energy = particles.energy;
+
+  // PDG codes are stored unsigned in the input, antiparticles wrap around
+  auto same_species = [](ULong_t particle_id, G4int pdg) { return static_cast<G4int>(particle_id) == pdg; };
+
+  // species
+  if (!params_.species_whitelist.empty()) {
+    std::fill(species_ok_.begin(), species_ok_.end(), 0);
+    for (G4int pdg: params_.species_whitelist)
+      for (size_t i = 0; i < size; ++i)
+        species_ok_[i] |= static_cast<uint8_t>(same_species(id[i], pdg));
+  }
+  for (G4int pdg: params_.species_blacklist)
+    for (size_t i = 0; i < size; ++i)
+      species_ok_[i] &= static_cast<uint8_t>(!same_species(id[i], pdg));
+
+  // energy thresholds, species without their own threshold get the default one
+  std::vector<uint8_t>& has_threshold = kept;
+  std::fill(has_threshold.begin(), has_threshold.end(), 0);
+  for (const auto& [pdg, threshold]: params_.energy_thresholds) {
+    for (size_t i = 0; i < size; ++i) {
+      uint8_t match = same_species(id[i], pdg);
+      has_threshold[i] |= match;
+      energy_ok_[i] &= static_cast<uint8_t>(!match | (energy[i] >= threshold));
+    }
+  }
+  const G4double default_threshold = params_.default_energy_threshold;
+  for (size_t i = 0; i < size; ++i)
+    energy_ok_[i] &= static_cast<uint8_t>(has_threshold[i] | (energy[i] >= default_threshold));
+
+  // arrival time from the plane front moving against the axis towards the origin of the shower
+  if (params_.use_time_window) {
+    // coordinates are in Geant4 length units, so the times come out in Geant4 time units
+    const G4double axis_x = std::sin(theta * deg) * std::cos(phi * deg) / c_light;
+    const G4double axis_y = std::sin(theta * deg) * std::sin(phi * deg) / c_light;
+    const G4double axis_z = std::cos(theta * deg) / c_light;
+    const G4double time_min = params_.time_window_min, time_max = params_.time_window_max;
+
+    const Double_t* x = particles.x;
+    const Double_t* y = particles.y;
+    const Double_t* z = particles.z;
+    for (size_t i = 0; i < size; ++i) {
+      const G4double time = -(x[i] * axis_x + y[i] * axis_y + z[i] * axis_z);
+      time_ok_[i] = static_cast<uint8_t>((time >= time_min) & (time <= time_max));
+    }
+  }
+
+  for (size_t i = 0; i < size; ++i) {
+    counts.species += !species_ok_[i];
+    counts.energy += species_ok_[i] & !energy_ok_[i];
+    counts.time += species_ok_[i] & energy_ok_[i] & !time_ok_[i];
+    kept[i] = species_ok_[i] & energy_ok_[i] & time_ok_[i];
+  }
+
+  return counts;
+}
+
+}  // namespace nevod
\ No newline at end of file
@@ -4,114 +4,192 @@ namespace nevod {
 
 PrimaryGeneratorAction::PrimaryGeneratorAction(Communicator* communicator, InputManager* input_manager)
     : G4VUserPrimaryGeneratorAction(), communicator_(communicator), input_manager_(input_manager) {
-  current_epoch_ = 0;
   epoch_num_ = communicator_->GetTotalEpochNum();
+  // first event of the thread picks up a shower
+  current_epoch_ = epoch_num_;
 
   auto params = communicator_->GetSimulationParams();
   input_path_ = params.input_path;
+  culling_mode_ = params.culling_mode;
+  physics_filter_ = new PhysicsFilter(params.primary_filter);
+  transform_ = new ShowerTransform(params.epoch_transform, params.seed);
 
   event_data_ = communicator_->GetEventData();
+  checkpoint_ = &communicator_->GetCheckpoint();
 
-  // Set number of primary particles generated in single gun
-  G4int particle_num = 1;
-  particle_gun_ = new G4ParticleGun(particle_num);
+  shower_generator_ = new ShowerGenerator(&particle_lookup_);
 }
 
-PrimaryGeneratorAction::~PrimaryGeneratorAction() { delete particle_gun_; }
+PrimaryGeneratorAction::~PrimaryGeneratorAction() {
+  delete shower_generator_;
+  delete acceptance_filter_;
+  delete physics_filter_;
+  delete transform_;
+}
 
-const G4ParticleGun* PrimaryGeneratorAction::GetParticleGun() const { return particle_gun_; }
+const ShowerGenerator* PrimaryGeneratorAction::GetShowerGenerator() const { return shower_generator_; }
 
 void PrimaryGeneratorAction::GeneratePrimaries(G4Event* event) {
+  ShowerSplitter& splitter = input_manager_->GetSplitter();
+
+  // chunks of split showers are taken before a new shower is read
   if (current_epoch_ >= epoch_num_) {
-    current_epoch_ = 0;
-    ReadEvents();
+    while (!splitter.Next(chunk_)) {
+      // a shower split by another thread while this one found the input empty still gets its help
+      if (!ReadEvents() && !splitter.Next(chunk_)) {
+        // every unit is taken, this thread stops and the run ends when the last one does
+        if (input_manager_->HasInputError()) LOG_ERROR("No readable input is left, aborting the run");
+        event_data_->input_ended = true;
+        event->SetEventAborted();
+        G4RunManager::GetRunManager()->AbortRun(true);
+        return;
+      }
+      if (chunk_.split || current_epoch_ < epoch_num_) break;
+    }
   }
 
-  communicator_->SetCurrentEpoch(current_epoch_);
+  event_data_->split = chunk_.split;
 
-  // launch the particles
-  G4ParticleTable* particle_table = G4ParticleTable::GetParticleTable();
+  ShowerPtr shower = event_data_->shower;
+  const std::vector<uint8_t>* kept = &kept_;
+  size_t begin = 0, end = kept_.size();
+  G4int epoch = current_epoch_;
 
-  for (size_t i = 0; i < event_data_->particles.size(); i++) {
-    ParticleData particle = event_data_->particles[i];
+  if (chunk_.split) {
+    const SplitShower& split = *chunk_.split;
 
-    G4ParticleDefinition* particle_definition = nullptr;
-    if (use_ui)
-      particle_definition = particle_table->FindParticle("geantino");
-    else
-      particle_definition = particle_table->FindParticle(particle.particle_id);
+    // header of the split shower, the columns are rebound only when the shower changes
+    if (event_data_->shower != split.shower) event_data_->SetShower(split.shower);
+    event_data_->split_epoch = chunk_.epoch;
+    event_data_->filtered_species = split.filtered_species;
+    event_data_->filtered_energy = split.filtered_energy;
+    event_data_->filtered_time = split.filtered_time;
 
-    if (particle_definition == nullptr && communicator_->GetSimulationParams().verbose) {
-      G4cout << "Didn't find particle \"" << particle.particle_id << "\". Skipping it." << G4endl;
-      continue;
-    }
+    shower = split.shower;
+    kept = &split.launch;
+    begin = chunk_.begin;
+    end = chunk_.end;
+    epoch = chunk_.epoch;
 
-    // -1 * z because angles are the angles of origin, not direction
-    event_data_->theta_rec = std::acos(-1 * particle.momentum.Z()) * 180. / M_PI;
+    chunk_ = ShowerChunk();
+  } else {
+    current_epoch_ = SkipDoneEpochs(current_epoch_ + 1);
+  }
 
-    event_data_->phi_rec = std::atan2(particle.momentum.Y(), particle.momentum.X()) * 180. / M_PI;
+  communicator_->SetCurrentEpoch(epoch);
 
-    if (event_data_->phi_rec < 0.0) event_data_->phi_rec += 360.0;
+  // same transform for every chunk of the epoch, culling sees the moved core
+  ParticleView particles = transform_->Apply(*shower, epoch, begin, end);
+  event_data_->core_x = transform_->core_x / m;
+  event_data_->core_y = transform_->core_y / m;
+  event_data_->rotation = transform_->rotation;
+  event_data_->phi = std::fmod(shower->phi + transform_->rotation, 360.);
 
-    G4double momentum_abs = std::hypot(particle.momentum.X(), particle.momentum.Y());
+  CullPrimaries(particles, kept->data() + begin);
+  LaunchPrimaries(event, particles, kept->data() + begin);
 
-    G4ThreeVector start_position =
-        G4ThreeVector((particle.coordinate.X() - shift_x), (particle.coordinate.Y() - shift_y), (particle.coordinate.Z() - shift_z));
+  LOG_DEBUG("Launched event " << event->GetEventID() << " (epoch " << epoch << ")");
 
-    G4ThreeVector start_momentum =
-        G4ThreeVector(particle.momentum.X() / momentum_abs, particle.momentum.Y() / momentum_abs, particle.momentum.Z() / momentum_abs);
+  event_data_->start_time = std::chrono::steady_clock::now();
+}
 
-    particle_gun_->SetParticleDefinition(particle_definition);
-    particle_gun_->SetParticlePosition(start_position);
-    particle_gun_->SetParticleMomentumDirection(start_momentum);
-    particle_gun_->SetParticleEnergy(particle.energy);
+void PrimaryGeneratorAction::LaunchPrimaries(G4Event* event, const ParticleView& particles, const uint8_t* kept) {
+  G4bool drop_culled = culling_mode_ == CullingMode::DROP;
 
-    particle_gun_->GeneratePrimaryVertex(event);
-  }
+  launch_.resize(particles.size);
+  for (size_t i = 0; i < particles.size; ++i)
+    launch_[i] = kept[i] && (!drop_culled || accepted_[i]);
 
-  G4cout << "Launched event " << event->GetEventID() << G4endl;
+  if (use_ui) shower_generator_->SetDefinition(G4ParticleTable::GetParticleTable()->FindParticle("geantino"));
 
-  event_data_->start_time = std::chrono::steady_clock::now();
+  shower_generator_->SetPrimaries(particles, launch_.data(), G4ThreeVector(shift_x, shift_y, shift_z));
+  shower_generator_->GeneratePrimaryVertex(event);
+
+  if (shower_generator_->GetLaunchedNumber() == 0) return;
 
-  current_epoch_++;
+  // direction of the last launched primary, -1 * z because angles are the angles of origin, not direction
+  size_t last = shower_generator_->GetLastLaunched();
+  event_data_->theta_rec = std::acos(-1 * particles.pz[last]) * 180. / M_PI;
+
+  event_data_->phi_rec = std::atan2(particles.py[last], particles.px[last]) * 180. / M_PI;
+
+  if (event_data_->phi_rec < 0.0) event_data_->phi_rec += 360.0;
 }
 
-void PrimaryGeneratorAction::ReadEvents() {
-  auto file = input_manager_->GetNextFile();
+void PrimaryGeneratorAction::BuildParticleLookup() { particle_lookup_.Build(); }
+
+void PrimaryGeneratorAction::PrintParticleSummary() const { particle_lookup_.PrintSummary(); }
 
-  auto input_file = new TFile((input_path_ + file.GetFileName()).c_str(), "READ");
+G4bool PrimaryGeneratorAction::ReadEvents() {
+  // shower is already decoded by the input manager, only the pointer changes hands
+  ShowerPtr next_shower = input_manager_->GetNextShower();
+  if (!next_shower) return false;
 
-  auto header_tree = (TTree*)input_file->Get("HeaderTree");
-  auto particles_tree = (TTree*)input_file->Get("ParticlesTree");
+  event_data_->SetShower(std::move(next_shower));
+  event_data_->header_pending = true;
 
-  event_data_->Clear();
+  FilterPrimaries();
 
-  if (!header_read_) {
-    header_tree->SetBranchAddress("EventID", &event_data_->event_id);
-    header_tree->SetBranchAddress("PrimaryParticleID", &event_data_->primary_particle_id);
-    header_tree->SetBranchAddress("ParticleAmount", &event_data_->particle_amount);
-    header_tree->SetBranchAddress("Theta", &event_data_->theta);
-    header_tree->SetBranchAddress("Phi", &event_data_->phi);
+  const auto& shower = event_data_->shower;
 
-    header_tree->GetEntry(0);
-    header_read_ = true;
+  G4int chunk_num = input_manager_->GetSplitter().GetChunkNumber(shower->view.size);
+  if (chunk_num == 1) {
+    current_epoch_ = SkipDoneEpochs(0);
+    return true;
   }
 
-  for (Long64_t i = 0; i < particles_tree->GetEntries(); ++i) {
-    ParticleData particle;
+  std::vector<G4int> epochs;
+  for (size_t epoch = SkipDoneEpochs(0); epoch < epoch_num_; epoch = SkipDoneEpochs(epoch + 1))
+    epochs.push_back(epoch);
 
-    particles_tree->SetBranchAddress("ParticleID", &particle.particle_id);
-    particles_tree->SetBranchAddress("ParticleNum", &particle.particle_num);
-    particles_tree->SetBranchAddress("Coordinate", &particle.coordinate);
-    particles_tree->SetBranchAddress("Momentum", &particle.momentum);
-    particles_tree->SetBranchAddress("Energy", &particle.energy);
+  // every epoch of a large shower runs as chunks on all threads
+  auto split = std::make_shared<SplitShower>(shower, kept_, epochs, chunk_num);
+  split->filtered_species = filter_counts_.species;
+  split->filtered_energy = filter_counts_.energy;
+  split->filtered_time = filter_counts_.time;
+  input_manager_->GetSplitter().Post(split);
 
-    particles_tree->GetEntry(i);
-    event_data_->particles.push_back(particle);
+  current_epoch_ = epoch_num_;
+  return true;
+}
+
+size_t PrimaryGeneratorAction::SkipDoneEpochs(size_t epoch) const {
+  const std::string& source = event_data_->shower->source;
+  while (epoch < epoch_num_ && checkpoint_->IsDone(source, epoch))
+    epoch++;
+  return epoch;
+}
+
+void PrimaryGeneratorAction::FilterPrimaries() {
+  const auto& shower = event_data_->shower;
+
+  filter_counts_ = physics_filter_->Apply(shower->view, shower->theta, shower->phi, kept_);
+
+  event_data_->filtered_species = filter_counts_.species;
+  event_data_->filtered_energy = filter_counts_.energy;
+  event_data_->filtered_time = filter_counts_.time;
+}
+
+void PrimaryGeneratorAction::CullPrimaries(const ParticleView& particles, const uint8_t* kept) {
+  event_data_->culled_count = 0;
+  event_data_->culled_energy = 0;
+
+  if (culling_mode_ == CullingMode::DISABLED) {
+    accepted_.assign(particles.size, 1);
+    return;
   }
 
-  input_file->Close();
-  delete input_file;
+  // geometry is built by the master before the first shower is read
+  if (acceptance_filter_ == nullptr)
+    acceptance_filter_ = new AcceptanceFilter(communicator_->GetAcceptanceBoxes(), communicator_->GetSimulationParams().culling_margin);
+
+  acceptance_filter_->Apply(particles, G4ThreeVector(shift_x, shift_y, shift_z), accepted_);
+
+  // primaries removed by the physics cuts are not counted twice
+  for (size_t i = 0; i < particles.size; ++i) {
+    event_data_->culled_count += kept[i] & !accepted_[i];
+    event_data_->culled_energy += (kept[i] && !accepted_[i]) ? particles.energy[i] : 0.;
+  }
 }
 
 }  // namespace nevod
\ No newline at end of file
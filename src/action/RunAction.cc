@@ -2,11 +2,17 @@
 
 namespace nevod {
 
-RunAction::RunAction(Communicator* communicator): G4UserRunAction(), communicator_(communicator) {}
+RunAction::RunAction(Communicator* communicator, PrimaryGeneratorAction* primary_generator_action)
+    : G4UserRunAction(), primary_generator_action_(primary_generator_action), communicator_(communicator) {}
 
 RunAction::~RunAction() = default;
 
-void RunAction::BeginOfRunAction(const G4Run* run) { G4RunManager::GetRunManager()->SetRandomNumberStore(false); }
+void RunAction::BeginOfRunAction(const G4Run* run) {
+  G4RunManager::GetRunManager()->SetRandomNumberStore(false);
+
+  // physics is constructed by now, so the particle table is complete
+  if (primary_generator_action_) primary_generator_action_->BuildParticleLookup();
+}
 
 void RunAction::EndOfRunAction(const G4Run* run) {
   G4int events_num = run->GetNumberOfEvent();
@@ -15,6 +21,7 @@ void RunAction::EndOfRunAction(const G4Run* run) {
     G4cout << "====================== END OF RUN ======================" << G4endl << G4endl;
   } else {
     G4cout << "--------------- End of thread-local run ---------------" << G4endl;
+    if (primary_generator_action_) primary_generator_action_->PrintParticleSummary();
   }
 }
 
@@ -0,0 +1,67 @@
+#include "action/ShowerGenerator.hh"
+
+namespace nevod {
+
+size_t ShowerGenerator::OriginHash::operator()(const Origin& origin) const {
+  uint64_t bits[3];
+  std::memcpy(bits, &origin, sizeof(bits));
+
+  uint64_t hash = bits[0];
+  hash = (hash ^ (bits[1] + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2)));
+  hash = (hash ^ (bits[2] + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2)));
+  return hash;
+}
+
+ShowerGenerator::ShowerGenerator(ParticleLookup* lookup): G4VPrimaryGenerator(), lookup_(lookup) {}
+
+void ShowerGenerator::SetPrimaries(const ParticleView& particles, const uint8_t* launch, const G4ThreeVector& shift) {
+  particles_ = &particles;
+  launch_ = launch;
+  shift_ = shift;
+}
+
+void ShowerGenerator::SetDefinition(G4ParticleDefinition* definition) { definition_ = definition; }
+
+void ShowerGenerator::GeneratePrimaryVertex(G4Event* event) {
+  const ParticleView& particles = *particles_;
+
+  vertices_.clear();
+  vertices_.reserve(particles.size);
+  launched_num_ = 0;
+
+  for (size_t i = 0; i < particles.size; ++i) {
+    if (!launch_[i]) continue;
+
+    // unknown codes are counted by the lookup and reported at the end of the run
+    G4ParticleDefinition* definition = definition_ ? definition_ : lookup_->Find(particles.particle_id[i]);
+    if (definition == nullptr) continue;
+
+    // a zero momentum has no direction, such rows are counted and skipped like unknown codes
+    G4double momentum_abs = std::sqrt(particles.px[i] * particles.px[i] + particles.py[i] * particles.py[i] + particles.pz[i] * particles.pz[i]);
+    if (momentum_abs == 0) {
+      lookup_->CountZeroMomentum();
+      continue;
+    }
+
+    auto [vertex, created] = vertices_.try_emplace(Origin{particles.x[i], particles.y[i], particles.z[i]}, nullptr);
+    if (created) {
+      G4ThreeVector position(particles.x[i] - shift_.x(), particles.y[i] - shift_.y(), particles.z[i] - shift_.z());
+      vertex->second = new G4PrimaryVertex(position, 0.);
+      event->AddPrimaryVertex(vertex->second);
+    }
+
+    auto primary = new G4PrimaryParticle(definition);
+    primary->SetMomentumDirection(G4ThreeVector(particles.px[i] / momentum_abs, particles.py[i] / momentum_abs, particles.pz[i] / momentum_abs));
+    primary->SetKineticEnergy(particles.energy[i]);
+    vertex->second->SetPrimary(primary);
+
+    last_launched_ = i;
+    launched_num_++;
+  }
+}
+
+size_t ShowerGenerator::GetLastLaunched() const { return last_launched_; }
+
+size_t ShowerGenerator::GetLaunchedNumber() const { return launched_num_; }
+
+}  // namespace nevod
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "action/ShowerTransform.hh"
+
+namespace nevod {
+
+ShowerTransform::ShowerTransform(const EpochTransformParams& params, G4int seed): params_(params), seed_(Mix(seed)) {}
+
+G4bool ShowerTransform::IsEnabled() const { return params_.core_half_x > 0 || params_.core_half_y > 0 || params_.random_azimuth; }
+
+// splitmix64 finalizer
+uint64_t ShowerTransform::Mix(uint64_t value) {
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+uint64_t ShowerTransform::GetShowerKey(const Shower& shower) {
+  uint64_t theta_bits, phi_bits;
+  std::memcpy(&theta_bits, &shower.theta, sizeof(theta_bits));
+  std::memcpy(&phi_bits, &shower.phi, sizeof(phi_bits));
+
+  uint64_t key = Mix(shower.event_id);
+  for (uint64_t value: {uint64_t(shower.primary_particle_id), uint64_t(shower.particle_amount), theta_bits, phi_bits, uint64_t(shower.view.size)})
+    key = Mix(key ^ value);
+  return key;
+}
+
+ParticleView ShowerTransform::Apply(const Shower& shower, G4int epoch, size_t begin, size_t end) {
+  const ParticleView& source = shower.view;
+
+  ParticleView particles;
+  particles.size = end - begin;
+  particles.particle_id = source.particle_id + begin;
+  particles.particle_num = source.particle_num + begin;
+  particles.x = source.x + begin;
+  particles.y = source.y + begin;
+  particles.z = source.z + begin;
+  particles.px = source.px + begin;
+  particles.py = source.py + begin;
+  particles.pz = source.pz + begin;
+  particles.energy = source.energy + begin;
+
+  core_x = 0;
+  core_y = 0;
+  rotation = 0;
+
+  if (!IsEnabled()) return particles;
+
+  // three independent uniform numbers in [0, 1) for this shower and epoch
+  uint64_t state = Mix(seed_ ^ GetShowerKey(shower)) ^ Mix(uint64_t(epoch));
+  auto uniform = [&state]() { return Double_t((state = Mix(state)) >> 11) * 0x1.0p-53; };
+
+  Double_t shift_x = (2 * uniform() - 1) * params_.core_half_x;
+  Double_t shift_y = (2 * uniform() - 1) * params_.core_half_y;
+  Double_t angle = params_.random_azimuth ? 2 * M_PI * uniform() : 0.;
+
+  core_x = shift_x;
+  core_y = shift_y;
+  rotation = angle * 180. / M_PI;
+
+  const Double_t cos_angle = std::cos(angle), sin_angle = std::sin(angle);
+
+  x_.resize(particles.size);
+  y_.resize(particles.size);
+  px_.resize(particles.size);
+  py_.resize(particles.size);
+
+  for (size_t i = 0; i < particles.size; ++i) {
+    x_[i] = particles.x[i] * cos_angle - particles.y[i] * sin_angle + shift_x;
+    y_[i] = particles.x[i] * sin_angle + particles.y[i] * cos_angle + shift_y;
+    px_[i] = particles.px[i] * cos_angle - particles.py[i] * sin_angle;
+    py_[i] = particles.px[i] * sin_angle + particles.py[i] * cos_angle;
+  }
+
+  particles.x = x_.data();
+  particles.y = y_.data();
+  particles.px = px_.data();
+  particles.py = py_.data();
+
+  return particles;
+}
+
+}  // namespace nevod
\ No newline at end of file
@@ -15,10 +15,7 @@ void SteppingAction::UserSteppingAction(const G4Step* step) {
     auto start = communicator_->GetEventStartTime();
     auto sim_time = std::chrono::duration_cast<std::chrono::minutes>(end - start);
     if (sim_time.count() >= 1.0) {
-      G4cout << "\n!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n"
-             << "\n  EXCEEDED TIME LIMIT! ABORTING EVENT SIMULATION  \n"
-             << "\n!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n"
-             << G4endl;
+      LOG_WARNING("Exceeded time limit, aborting event " << G4EventManager::GetEventManager()->GetConstCurrentEvent()->GetEventID());
       G4UImanager* ui_manager = G4UImanager::GetUIpointer();
       ui_manager->ApplyCommand("/event/abort");
     }
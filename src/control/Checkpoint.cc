@@ -0,0 +1,80 @@
+#include "control/Checkpoint.hh"
+
+namespace nevod {
+
+Checkpoint::Checkpoint(const std::string& output_dir, G4bool resume): output_dir_(output_dir) {
+  // a fresh run writes the first shard, its output is cleaned once it is opened
+  if (!resume || !fs::exists(output_dir_)) return;
+
+  for (const auto& entry: fs::directory_iterator(output_dir_)) {
+    std::string name = entry.path().filename().string();
+    if (name.rfind(CHECKPOINT_PREFIX, 0) != 0 || entry.path().extension() != CHECKPOINT_EXTENSION) continue;
+
+    // next shard goes after every shard written so far
+    auto part = name.find("_part");
+    G4int shard = part == std::string::npos ? 0 : std::stoi(name.substr(part + 5));
+    shard_ = std::max(shard_, shard + 1);
+
+    std::ifstream file(entry.path());
+    std::string line;
+    while (std::getline(file, line)) {
+      // line without the newline was cut by the crash
+      if (file.eof()) break;
+
+      auto tab = line.find('\t');
+      if (tab == std::string::npos) continue;
+      done_[line.substr(0, tab)].insert(std::stoi(line.substr(tab + 1)));
+    }
+  }
+
+  LOG_INFO("Resuming run: " << GetUnitNumber() << " finished units, writing shard" << GetShardSuffix());
+}
+
+size_t Checkpoint::RemoveFiles(const std::string& output_dir) {
+  if (!fs::exists(output_dir)) return 0;
+
+  std::vector<fs::path> stale;
+  for (const auto& entry: fs::directory_iterator(output_dir)) {
+    std::string name = entry.path().filename().string();
+    if (name.rfind(CHECKPOINT_PREFIX, 0) == 0 && entry.path().extension() == CHECKPOINT_EXTENSION) stale.push_back(entry.path());
+  }
+
+  for (const auto& path: stale)
+    fs::remove(path);
+  return stale.size();
+}
+
+std::string Checkpoint::GetShardSuffix() const { return shard_ == 0 ? "" : "_part" + std::to_string(shard_); }
+
+G4bool Checkpoint::IsDone(const std::string& file, G4int epoch) const {
+  auto found = done_.find(file);
+  return found != done_.end() && found->second.count(epoch) > 0;
+}
+
+G4int Checkpoint::GetDoneNumber(const std::string& file, G4int epoch_num) const {
+  auto found = done_.find(file);
+  if (found == done_.end()) return 0;
+  return std::distance(found->second.begin(), found->second.lower_bound(epoch_num));
+}
+
+size_t Checkpoint::GetUnitNumber() const {
+  size_t unit_num = 0;
+  for (const auto& [file, epochs]: done_)
+    unit_num += epochs.size();
+  return unit_num;
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& path): file_(path, std::ios::trunc) {
+  if (!file_.is_open()) throw std::runtime_error("Cannot write checkpoint: " + path);
+}
+
+void CheckpointWriter::Add(const std::string& file, G4int epoch) { pending_.emplace_back(file, epoch); }
+
+void CheckpointWriter::Flush() {
+  for (const auto& [file, epoch]: pending_)
+    file_ << file << '\t' << epoch << '\n';
+  file_.flush();
+  pending_.clear();
+}
+
+}  // namespace nevod
\ No newline at end of file
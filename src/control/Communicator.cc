@@ -1,6 +1,8 @@
 #include "control/Communicator.hh"
 
 namespace nevod {
+G4ThreadLocal EventContext Communicator::context_;
+
 SimulationParams::SimulationParams(const G4String& config_path) {
   YAML::Node config = YAML::LoadFile(config_path);
 
@@ -8,8 +10,69 @@ SimulationParams::SimulationParams(const G4String& config_path) {
   epoch_num = config["epochs"].as<G4int>();
   batch_size = config["batch_size"].as<G4int>();
   initial_offset = config["initial_offset"].as<G4int>();
+  prefetch_depth = config["prefetch_depth"].as<G4int>(prefetch_depth);
+  io_thread_num = config["io_thread_num"].as<G4int>(io_thread_num);
+  discovery_thread_num = config["discovery_thread_num"].as<G4int>(discovery_thread_num);
+  shower_store_size = config["shower_store_size"].as<G4int>(shower_store_size);
+  lease_size = config["lease_size"].as<G4int>(lease_size);
+  std::string culling = config["culling_mode"].as<std::string>("off");
+  if (culling == "flag")
+    culling_mode = CullingMode::FLAG;
+  else if (culling == "drop")
+    culling_mode = CullingMode::DROP;
+  else if (culling != "off")
+    throw std::invalid_argument("Unknown culling mode: " + culling);
+  culling_margin = config["culling_margin"].as<G4double>(culling_margin / m) * m;
+  split_threshold = config["split_threshold"].as<G4int>(split_threshold);
+  split_chunk_num = config["split_chunk_num"].as<G4int>(split_chunk_num);
+
+  if (auto filter = config["primary_filter"]) {
+    if (auto thresholds = filter["energy_thresholds"]) {
+      for (const auto& threshold: thresholds) {
+        auto species = threshold.first.as<std::string>();
+        if (species == "default")
+          primary_filter.default_energy_threshold = threshold.second.as<G4double>();
+        else
+          primary_filter.energy_thresholds[std::stoi(species)] = threshold.second.as<G4double>();
+      }
+    }
+    primary_filter.species_whitelist = filter["species_whitelist"].as<std::vector<G4int>>(primary_filter.species_whitelist);
+    primary_filter.species_blacklist = filter["species_blacklist"].as<std::vector<G4int>>(primary_filter.species_blacklist);
+    if (auto window = filter["arrival_time_window"]; window && window.size() == 2) {
+      primary_filter.use_time_window = true;
+      primary_filter.time_window_min = window[0].as<G4double>() * ns;
+      primary_filter.time_window_max = window[1].as<G4double>() * ns;
+    }
+  }
+  if (auto area = config["core_area"]; area && area.size() == 2) {
+    epoch_transform.core_half_x = area[0].as<G4double>() * m;
+    epoch_transform.core_half_y = area[1].as<G4double>() * m;
+  }
+  epoch_transform.random_azimuth = config["random_azimuth"].as<G4bool>(epoch_transform.random_azimuth);
   input_path = config["input_file_path"].as<std::string>();
+  input_stream_path = config["input_stream_path"].as<std::string>(input_stream_path);
+  stream_shower_num = config["stream_shower_num"].as<G4int>(stream_shower_num);
   output_dir_path = config["output_dir_path"].as<std::string>();
+  resume = config["resume"].as<G4bool>(resume);
+  checkpoint_interval = config["checkpoint_interval"].as<G4int>(checkpoint_interval);
+  output_queue_size = config["output_queue_size"].as<G4int>(output_queue_size);
+  output_flush_interval = config["output_flush_interval"].as<G4int>(output_flush_interval);
+  output_policy.sparse = config["sparse_output"].as<G4bool>(output_policy.sparse);
+  if (auto policy = config["output_policy"]) {
+    output_policy.compression = policy["compression"].as<std::string>(output_policy.compression);
+    output_policy.compression_level = policy["compression_level"].as<G4int>(output_policy.compression_level);
+    output_policy.compact_types = policy["compact_types"].as<G4bool>(output_policy.compact_types);
+    output_policy.float_precision = policy["float_precision"].as<G4bool>(output_policy.float_precision);
+  }
+  std::string format = config["output_format"].as<std::string>("ttree");
+  if (format == "rntuple")
+    output_format = OutputFormat::RNTUPLE;
+  else if (format != "ttree")
+    throw std::invalid_argument("Unknown output format: " + format);
+  merge_output = config["merge_output"].as<G4bool>(merge_output);
+  merge_thread_num = config["merge_thread_num"].as<G4int>(merge_thread_num);
+  merge_sort = config["merge_sort"].as<G4bool>(merge_sort);
+  merge_delete_inputs = config["merge_delete_inputs"].as<G4bool>(merge_delete_inputs);
   verbose = config["verbose"].as<G4bool>();
   config_qsm = config["use_old_nevod_configs"].as<G4bool>() ? CherenkovConfig::OLD_CONFIGURATION : CherenkovConfig::NEW_CONFIGURATION;
   config_sct = config["use_old_sct_configs"].as<G4bool>() ? SCTConfig::OLD_CONFIGURATION : SCTConfig::NEW_CONFIGURATION;
@@ -17,24 +80,35 @@ SimulationParams::SimulationParams(const G4String& config_path) {
   seed = config["seed"].as<G4int>();
   save_logs = config["save_verbose_output_flag"].as<G4bool>();
   log_save_dir_path = config["save_verbose_output_dir"].as<std::string>();
+  log_level = Logger::ParseLevel(config["log_level"].as<std::string>(verbose ? "info" : "warning"));
 
-  if (!fs::exists(input_path)) throw std::runtime_error("Input directory does not exist: " + input_path);
+  if (input_stream_path.empty() && !fs::exists(input_path)) throw std::runtime_error("Input directory does not exist: " + input_path);
+
+  // throws on an unknown algorithm
+  output_policy.GetCompressionSettings();
+
+  if (output_format == OutputFormat::RNTUPLE && merge_sort) throw std::invalid_argument("Sorted merge is only implemented for the ttree output");
+
+  if (!input_stream_path.empty() && stream_shower_num <= 0) throw std::invalid_argument("Number of showers to read from the stream is not set");
+  // the event count of a stream is known only in showers, the chunks of split ones would not be run
+  if (!input_stream_path.empty() && split_threshold > 0) throw std::invalid_argument("Shower splitting is not supported for the input stream");
 
   if (!fs::exists(output_dir_path)) fs::create_directories(output_dir_path);
 
   if (save_logs && !fs::exists(log_save_dir_path)) fs::create_directories(log_save_dir_path);
 
   if (thread_num == -1) thread_num = G4Threading::G4GetNumberOfCores() - 1;
+  if (discovery_thread_num == -1) discovery_thread_num = G4Threading::G4GetNumberOfCores();
+  if (merge_thread_num == -1) merge_thread_num = G4Threading::G4GetNumberOfCores();
 }
 
-Communicator::Communicator(const G4String& config_path): current_progress_(0.0) {
-  simulation_params_ = SimulationParams(config_path);
+Communicator::Communicator(const G4String& config_path): Communicator(SimulationParams(config_path)) {}
 
-  event_data_.resize(simulation_params_.thread_num);
-
-  for (auto& data: event_data_) {
-    data = new EventData();
-  }
+Communicator::Communicator(const SimulationParams& params): current_progress_(0.0) {
+  simulation_params_ = params;
+  // started first, the checkpoint already reports through it
+  Logger::Instance().Start(simulation_params_.log_level, simulation_params_.save_logs, simulation_params_.log_save_dir_path);
+  checkpoint_ = Checkpoint(simulation_params_.output_dir_path, simulation_params_.resume);
 
   // TODO Need to initialize the rest of the data
 
@@ -42,6 +116,9 @@ Communicator::Communicator(const G4String& config_path): current_progress_(0.0)
 }
 
 Communicator::~Communicator() {
+  delete output_writer_;
+  Logger::Instance().Stop();
+
   for (auto& data: event_data_) {
     delete data;
   }
@@ -90,7 +167,19 @@ void Communicator::UpdateProgress(const G4double increment) {
 }
 
 void Communicator::MergeOutputFiles() const {
-  // TODO Implement merging of output files
+  if (!simulation_params_.merge_output) return;
+
+  OutputMergerParams params;
+  params.output_dir = simulation_params_.output_dir_path;
+  params.thread_num = simulation_params_.merge_thread_num;
+  params.sort = simulation_params_.merge_sort;
+  params.delete_inputs = simulation_params_.merge_delete_inputs;
+  params.compression_settings = simulation_params_.output_policy.GetCompressionSettings();
+
+  OutputMerger merger(params);
+  if (merger.FindInputs() == 0) return;
+
+  merger.Merge();
 }
 
 void Communicator::SetTotalEventCount(const G4int total_event_count) {
@@ -101,142 +190,123 @@ void Communicator::SetTotalEventCount(const G4int total_event_count) {
 void Communicator::SetCountPMT(const G4int count_pmt) {
   G4AutoLock lock(&mutex_);
   count_pmt_ = count_pmt;
-  ResetEventData();
+  UpdateEventLayout();
 }
 void Communicator::SetCountSCT(const G4int count_sct) {
   G4AutoLock lock(&mutex_);
   count_sct_ = count_sct;
-  ResetEventData();
+  UpdateEventLayout();
 }
 void Communicator::SetQSMId(const std::vector<PMTId>& id_qsm) {
   G4AutoLock lock(&mutex_);
   id_qsm_ = id_qsm;
-  ResetEventData();
+  UpdateEventLayout();
 }
 
 void Communicator::SetCounterId(const std::vector<CounterId>& id_sct) {
   G4AutoLock lock(&mutex_);
   id_sct_ = id_sct;
-  ResetEventData();
+  UpdateEventLayout();
 }
 
-void Communicator::SetCurrentEpoch(const G4int current_epoch) {
-  G4int thread_num = G4Threading::G4GetThreadId();
-  G4AutoLock lock(&mutex_);
-  current_epoch_[thread_num] = current_epoch;
-}
+void Communicator::SetCurrentEpoch(const G4int current_epoch) { context_.current_epoch = current_epoch; }
 
-SimulationParams& Communicator::GetSimulationParams() {
+void Communicator::AddAcceptanceBox(const G4ThreeVector& center, const G4ThreeVector& half_size) {
   G4AutoLock lock(&mutex_);
-  return simulation_params_;
+  acceptance_boxes_.push_back({center, half_size});
 }
 
-EventData* Communicator::GetEventData() {
-  G4int thread_num = G4Threading::G4GetThreadId();
-  G4AutoLock lock(&mutex_);
-  return event_data_[thread_num];
-}
+const SimulationParams& Communicator::GetSimulationParams() const { return simulation_params_; }
 
-G4int Communicator::GetCountPMT() {
-  G4AutoLock lock(&mutex_);
-  return count_pmt_;
-}
+void Communicator::AllocateEventData() { GetEventData()->Allocate(event_layout_); }
 
-G4int Communicator::GetCountSCT() {
+OutputWriter* Communicator::GetOutputWriter() {
   G4AutoLock lock(&mutex_);
-  return count_sct_;
-}
+  if (output_writer_) return output_writer_;
 
-PMTId Communicator::GetQSMId(const G4int copy_number) {
-  G4AutoLock lock(&mutex_);
-  return id_qsm_[copy_number];
-}
+  // a fresh run starts a new lineage of shards, neither the resume nor the merge may pick up the ones of an earlier run
+  if (!simulation_params_.resume) {
+    size_t removed = Checkpoint::RemoveFiles(simulation_params_.output_dir_path) + OutputMerger::RemoveOutputs(simulation_params_.output_dir_path);
+    if (removed > 0) LOG_WARNING("Removed " << removed << " checkpoints and output files of an earlier run");
+  }
 
-CounterId Communicator::GetCounterId(const G4int copy_number) {
-  G4AutoLock lock(&mutex_);
-  return id_sct_[copy_number];
+  // resumed runs write new shards, the old ones stay as they are
+  std::string shard = checkpoint_.GetShardSuffix();
+
+  OutputWriterParams params;
+  params.output_path = simulation_params_.output_dir_path + "/" + OUTPUT_PREFIX + shard + ".root";
+  params.checkpoint_path = simulation_params_.output_dir_path + "/" + CHECKPOINT_PREFIX + shard + CHECKPOINT_EXTENSION;
+  params.layout = event_layout_;
+  params.queue_size = std::max(simulation_params_.output_queue_size, 1);
+  params.flush_interval = simulation_params_.output_flush_interval;
+  params.checkpoint_interval = simulation_params_.checkpoint_interval;
+  params.epoch_num = simulation_params_.epoch_num;
+  // one shower per worker is in flight, the next one may start before the last event of the previous is written
+  params.binding_num = std::max(simulation_params_.thread_num, 1) + 1;
+  params.policy = simulation_params_.output_policy;
+  params.format = simulation_params_.output_format;
+
+  output_writer_ = new OutputWriter(params);
+  return output_writer_;
 }
 
-std::chrono::steady_clock::time_point Communicator::GetEventStartTime() {
+void Communicator::CloseOutput() {
   G4AutoLock lock(&mutex_);
-  return event_data_[G4Threading::G4GetThreadId()]->start_time;
+  if (output_writer_) output_writer_->Close();
 }
 
-G4int Communicator::GetMaxStepCount() {
-  G4AutoLock lock(&mutex_);
-  return simulation_params_.batch_size;
-}
-G4int Communicator::GetTotalEpochNum() {
-  G4AutoLock lock(&mutex_);
-  return simulation_params_.epoch_num;
-}
-G4int Communicator::GetCurrentEpoch() {
-  G4int thread_num = G4Threading::G4GetThreadId();
-  G4AutoLock lock(&mutex_);
-  return current_epoch_[thread_num];
+size_t Communicator::GetWrittenUnitNumber() const { return output_writer_ ? output_writer_->GetUnitNumber() : 0; }
+
+EventData* Communicator::GetEventData() {
+  if (!context_.event_data) {
+    G4AutoLock lock(&mutex_);
+    event_data_.push_back(new EventData());
+    context_.event_data = event_data_.back();
+  }
+  return context_.event_data;
 }
 
-void Communicator::ResetEventData() {
-  if (count_pmt_ == 0 || count_sct_ == 0 || id_qsm_.empty() || id_sct_.empty()) return;
+G4int Communicator::GetCountPMT() const { return count_pmt_; }
 
-  PMTId max_qsm = id_qsm_.back();
-  max_qsm.plane++;
-  max_qsm.stripe++;
-  max_qsm.module++;
-  max_qsm.tube++;
+G4int Communicator::GetCountSCT() const { return count_sct_; }
 
-  CounterId max_sct = id_sct_.back();
-  max_sct.side++;
-  max_sct.plane++;
-  max_sct.row++;
+const std::vector<AcceptanceBox>& Communicator::GetAcceptanceBoxes() const { return acceptance_boxes_; }
 
-  for (auto& data: event_data_) {
-    data->Clear();
-
-    // SCT
-    data->edep_count_sct.resize(max_sct.side);
-    for (G4int i = 0; i < max_sct.side; ++i) {
-      data->edep_count_sct[i].resize(max_sct.plane);
-      for (G4int j = 0; j < max_sct.plane; ++j) {
-        data->edep_count_sct[i][j].resize(max_sct.row);
-        for (G4int k = 0; k < max_sct.row; ++k) {
-          data->edep_count_sct[i][j][k] = 0;
-        }
-      }
-    }
+const Checkpoint& Communicator::GetCheckpoint() const { return checkpoint_; }
 
-    // DECOR
-    data->muon_decor.resize(8);
-    for (G4int i = 0; i < 8; ++i) {
-      data->muon_decor[i].resize(8);
-      for (G4int j = 0; j < 8; ++j) {
-        data->muon_decor[i][j].resize(2);
-        for (G4int k = 0; k < 2; ++k) {
-          data->muon_decor[i][j][k] = 0;
-        }
-      }
-    }
+std::chrono::steady_clock::time_point Communicator::GetEventStartTime() { return GetEventData()->start_time; }
 
-    // CherenkovWD NEVOD
-    data->photoelectron_num.resize(count_pmt_);
-    for (G4int i = 0; i < count_pmt_; ++i) {
-      data->photoelectron_num[i] = 0;
-    }
+G4int Communicator::GetMaxStepCount() const { return simulation_params_.batch_size; }
+G4int Communicator::GetTotalEpochNum() const { return simulation_params_.epoch_num; }
+G4int Communicator::GetCurrentEpoch() const { return context_.current_epoch; }
 
-    data->amplitude_qsm.resize(max_qsm.plane);
-    for (G4int i = 0; i < max_qsm.plane; ++i) {
-      data->amplitude_qsm[i].resize(max_qsm.stripe);
-      for (G4int j = 0; j < max_qsm.stripe; ++j) {
-        data->amplitude_qsm[i][j].resize(max_qsm.module);
-        for (G4int k = 0; k < max_qsm.module; ++k) {
-          data->amplitude_qsm[i][j][k].resize(max_qsm.tube);
-          for (G4int l = 0; l < max_qsm.tube; ++l) {
-            data->amplitude_qsm[i][j][k][l] = 0;
-          }
-        }
-      }
-    }
-  }
+void Communicator::UpdateEventLayout() {
+  if (count_pmt_ == 0 || count_sct_ == 0 || id_qsm_.empty() || id_sct_.empty()) return;
+
+  // rows of the SCT planes differ, so the shapes come from the largest index of every field
+  PMTId max_qsm{};
+  for (const auto& id: id_qsm_)
+    max_qsm = {std::max(max_qsm.plane, id.plane), std::max(max_qsm.stripe, id.stripe), std::max(max_qsm.module, id.module), std::max(max_qsm.tube, id.tube)};
+
+  CounterId max_sct{};
+  for (const auto& id: id_sct_)
+    max_sct = {std::max(max_sct.side, id.side), std::max(max_sct.plane, id.plane), std::max(max_sct.row, id.row)};
+
+  event_layout_.sct = {size_t(max_sct.side + 1), size_t(max_sct.plane + 1), size_t(max_sct.row + 1)};
+  event_layout_.decor = {8, 8, 2};
+  event_layout_.qsm = {size_t(max_qsm.plane + 1), size_t(max_qsm.stripe + 1), size_t(max_qsm.module + 1), size_t(max_qsm.tube + 1)};
+  // photoelectrons are counted by channel id
+  event_layout_.pmt_num = PMTChannel::SIZE;
+
+  const auto& qsm = event_layout_.qsm;
+  event_layout_.qsm_channels.clear();
+  for (const auto& id: id_qsm_)
+    event_layout_.qsm_channels.push_back(((id.plane * qsm[1] + id.stripe) * qsm[2] + id.module) * qsm[3] + id.tube);
+
+  const auto& sct = event_layout_.sct;
+  event_layout_.sct_channels.clear();
+  for (const auto& id: id_sct_)
+    event_layout_.sct_channels.push_back((id.side * sct[1] + id.plane) * sct[2] + id.row);
 }
 
 }  // namespace nevod
\ No newline at end of file
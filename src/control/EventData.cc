@@ -5,8 +5,12 @@ namespace nevod {
 void Particles::push_back(const ParticleData particle) {
   particle_id.push_back(particle.particle_id);
   particle_num.push_back(particle.particle_num);
-  coordinate.push_back(particle.coordinate);
-  momentum.push_back(particle.momentum);
+  x.push_back(particle.coordinate.X());
+  y.push_back(particle.coordinate.Y());
+  z.push_back(particle.coordinate.Z());
+  px.push_back(particle.momentum.X());
+  py.push_back(particle.momentum.Y());
+  pz.push_back(particle.momentum.Z());
   energy.push_back(particle.energy);
 }
 
@@ -24,16 +28,36 @@ void Particles::push_back(
 void Particles::resize(const size_t size) {
   particle_id.resize(size);
   particle_num.resize(size);
-  coordinate.resize(size);
-  momentum.resize(size);
+  x.resize(size);
+  y.resize(size);
+  z.resize(size);
+  px.resize(size);
+  py.resize(size);
+  pz.resize(size);
   energy.resize(size);
 }
 
+void Particles::reserve(const size_t size) {
+  particle_id.reserve(size);
+  particle_num.reserve(size);
+  x.reserve(size);
+  y.reserve(size);
+  z.reserve(size);
+  px.reserve(size);
+  py.reserve(size);
+  pz.reserve(size);
+  energy.reserve(size);
+}
+
 void Particles::clear() {
   particle_id.clear();
   particle_num.clear();
-  coordinate.clear();
-  momentum.clear();
+  x.clear();
+  y.clear();
+  z.clear();
+  px.clear();
+  py.clear();
+  pz.clear();
   energy.clear();
 }
 
@@ -41,18 +65,34 @@ ParticleData Particles::operator[](const size_t index) const {
   ParticleData particle;
   particle.particle_id = particle_id[index];
   particle.particle_num = particle_num[index];
-  particle.coordinate = coordinate[index];
-  particle.momentum = momentum[index];
+  particle.coordinate = TVector3(x[index], y[index], z[index]);
+  particle.momentum = TVector3(px[index], py[index], pz[index]);
   particle.energy = energy[index];
   return particle;
 }
 
 size_t Particles::size() const { return particle_id.size(); }
 
+void Shower::BindView() {
+  view.size = particles.size();
+  view.particle_id = particles.particle_id.data();
+  view.particle_num = particles.particle_num.data();
+  view.x = particles.x.data();
+  view.y = particles.y.data();
+  view.z = particles.z.data();
+  view.px = particles.px.data();
+  view.py = particles.py.data();
+  view.pz = particles.pz.data();
+  view.energy = particles.energy.data();
+}
+
+// Placeholder columns bound to the event tree until the first shower arrives
+static Particles no_particles;
+
 EventData::EventData(): EventData(0, 0, 0, 0, 0) {}
 EventData::EventData(ULong_t event_id, ULong_t primary_particle_id, ULong_t particle_amount, Double_t theta, Double_t phi)
     : event_id(event_id), primary_particle_id(primary_particle_id), particle_amount(particle_amount), theta(theta), phi(phi) {
-  particles.resize(particle_amount);
+  SetShower(nullptr);
   energy_dep = 0;
   particle_count = 0;
   track_length = 0;
@@ -63,41 +103,273 @@ EventData::EventData(ULong_t event_id, ULong_t primary_particle_id, ULong_t part
   duration = 0;
 
   muon_nevod = std::make_pair(TrackData(), TrackData());
-  muon_decor = vector3d<Double_t>();
-  muon_decor_w = vector3d<Double_t>();
-  edep_count_sct = vector3d<Double_t>();
-  amplitude_qsm = vector4d<Double_t>();
+}
+
+G4bool EventData::HasColumns(const Shower& shower) { return shower.particles.size() == shower.view.size; }
+
+void EventData::SetShower(ShowerPtr new_shower, Particles* columns) {
+  shower = std::move(new_shower);
+
+  Particles* output = &no_particles;
+  if (shower && columns) {
+    output = columns;
+  } else if (shower && HasColumns(*shower)) {
+    // ROOT only reads the columns on Fill, the shower itself stays immutable
+    output = const_cast<Particles*>(&shower->particles);
+  } else if (shower) {
+    const ParticleView& view = shower->view;
+    mapped_particles_.particle_id.assign(view.particle_id, view.particle_id + view.size);
+    mapped_particles_.particle_num.assign(view.particle_num, view.particle_num + view.size);
+    mapped_particles_.x.assign(view.x, view.x + view.size);
+    mapped_particles_.y.assign(view.y, view.y + view.size);
+    mapped_particles_.z.assign(view.z, view.z + view.size);
+    mapped_particles_.px.assign(view.px, view.px + view.size);
+    mapped_particles_.py.assign(view.py, view.py + view.size);
+    mapped_particles_.pz.assign(view.pz, view.pz + view.size);
+    mapped_particles_.energy.assign(view.energy, view.energy + view.size);
+    output = &mapped_particles_;
+  }
+
+  auto& particles = *output;
+  particle_id_column_ = &particles.particle_id;
+  particle_num_column_ = &particles.particle_num;
+  x_column_ = &particles.x;
+  y_column_ = &particles.y;
+  z_column_ = &particles.z;
+  px_column_ = &particles.px;
+  py_column_ = &particles.py;
+  pz_column_ = &particles.pz;
+  energy_column_ = &particles.energy;
+
+  source = shower ? shower->source : std::string();
+  if (!shower) return;
+
+  event_id = shower->event_id;
+  primary_particle_id = shower->primary_particle_id;
+  particle_amount = shower->particle_amount;
+  theta = shower->theta;
+  phi = shower->phi;
 }
 
 void EventData::ConnectHeaderTree(TTree* tree) {
   tree->Branch("EventID", &event_id, "eventId/L");
   tree->Branch("PrimaryParticleID", &primary_particle_id, "PrimaryParticleID/L");
   tree->Branch("ParticleAmount", &particle_amount, "ParticleAmount/L");
+  tree->Branch("FilteredSpecies", &filtered_species, "FilteredSpecies/L");
+  tree->Branch("FilteredEnergy", &filtered_energy, "FilteredEnergy/L");
+  tree->Branch("FilteredTime", &filtered_time, "FilteredTime/L");
   // TODO add writing configuration of experiments too
 }
 
-void EventData::ConnectEventTree(TTree* tree) {
+void EventData::ConnectEventTree(TTree* tree, const OutputPolicy& policy) {
+  // full precision column or its narrow copy, depending on the policy
+  auto count = [&](const char* name, ULong_t* full, UInt_t* narrow) {
+    if (policy.compact_types)
+      tree->Branch(name, narrow, (std::string(name) + "/i").c_str());
+    else
+      tree->Branch(name, full, (std::string(name) + "/L").c_str());
+  };
+  auto energy = [&](const char* name, Double_t* full, Float_t* narrow) {
+    if (policy.float_precision)
+      tree->Branch(name, narrow, (std::string(name) + "/F").c_str());
+    else
+      tree->Branch(name, full, (std::string(name) + "/D").c_str());
+  };
+  auto values = [&](const char* name, std::vector<Double_t>* full, auto* narrow, G4bool use_narrow) {
+    if (use_narrow)
+      tree->Branch(name, narrow);
+    else
+      tree->Branch(name, full);
+  };
+
+  // shower of the event, (source, epoch, event id) is also the sort key of merged outputs
+  tree->Branch("Source", &source);
+  tree->Branch("EventID", &event_id, "EventID/L");
   tree->Branch("Theta", &theta, "Theta/D");
   tree->Branch("Phi", &phi, "Phi/D");
   tree->Branch("ThetaReconstructed", &theta_rec, "ThetaReconstructed/D");
   tree->Branch("PhiReconstructed", &phi_rec, "PhiReconstructed/D");
-  tree->Branch("EnergyDeposition", &energy_dep, "EnergyDeposition/D");
-  tree->Branch("ParticleCount", &particle_count, "ParticleCount/L");
+  energy("EnergyDeposition", &energy_dep, &narrow_.energy_dep);
+  count("ParticleCount", &particle_count, &narrow_.particle_count);
   tree->Branch("TrackLength", &track_length, "TrackLength/D");
-  tree->Branch("MuonCount", &muon_count, "MuonCount/L");
-  tree->Branch("EnergyStart", &energy_start, "EnergyStart/D");
-  tree->Branch("EnergyEnd", &energy_end, "EnergyEnd/D");
-  tree->Branch("Duration", &duration, "Duration/D");
-  tree->Branch("DECOR", &muon_decor);
-  tree->Branch("DECORW", &muon_decor_w);
-  tree->Branch("SCT", &edep_count_sct);
-  tree->Branch("CherenkovWD", &amplitude_qsm);
-
-  tree->Branch("ParticleID", &particles.particle_id);
-  tree->Branch("ParticleNum", &particles.particle_num);
-  tree->Branch("Coordinate", &particles.coordinate);
-  tree->Branch("Momentum", &particles.momentum);
-  tree->Branch("Energy", &particles.energy);
+  count("MuonCount", &muon_count, &narrow_.muon_count);
+  energy("EnergyStart", &energy_start, &narrow_.energy_start);
+  energy("EnergyEnd", &energy_end, &narrow_.energy_end);
+  tree->Branch("Duration", &duration, "Duration/L");
+  tree->Branch("CoreX", &core_x, "CoreX/D");
+  tree->Branch("CoreY", &core_y, "CoreY/D");
+  tree->Branch("Rotation", &rotation, "Rotation/D");
+  count("CulledCount", &culled_count, &narrow_.culled_count);
+  energy("CulledEnergy", &culled_energy, &narrow_.culled_energy);
+  if (policy.sparse) {
+    // channels are dense offsets for DECOR and placement-order indices into the SCT and CherenkovWD channels of ChannelMapTree
+    tree->Branch("DECORChannel", &sparse_decor.channel);
+    values("DECORValue", &sparse_decor.value, &narrow_.decor, policy.compact_types);
+    tree->Branch("DECORWChannel", &sparse_decor_w.channel);
+    values("DECORWValue", &sparse_decor_w.value, &narrow_.decor_w, policy.compact_types);
+    tree->Branch("SCTChannel", &sparse_sct.channel);
+    values("SCTValue", &sparse_sct.value, &narrow_.sct, policy.float_precision);
+    tree->Branch("CherenkovWDChannel", &sparse_qsm.channel);
+    values("CherenkovWDValue", &sparse_qsm.value, &narrow_.qsm, policy.float_precision);
+  } else {
+    // flat arrays, the shapes are in ChannelMapTree
+    values("DECOR", &muon_decor.data, &narrow_.decor, policy.compact_types);
+    values("DECORW", &muon_decor_w.data, &narrow_.decor_w, policy.compact_types);
+    values("SCT", &edep_count_sct.data, &narrow_.sct, policy.float_precision);
+    values("CherenkovWD", &amplitude_qsm.data, &narrow_.qsm, policy.float_precision);
+  }
+
+  tree->Branch("ParticleID", &particle_id_column_);
+  tree->Branch("ParticleNum", &particle_num_column_);
+  tree->Branch("CoordinateX", &x_column_);
+  tree->Branch("CoordinateY", &y_column_);
+  tree->Branch("CoordinateZ", &z_column_);
+  tree->Branch("MomentumX", &px_column_);
+  tree->Branch("MomentumY", &py_column_);
+  tree->Branch("MomentumZ", &pz_column_);
+  tree->Branch("Energy", &energy_column_);
+}
+
+#ifdef NEVOD_WITH_RNTUPLE
+// Field owned by the model, refreshed from the event data before every fill
+template <typename T>
+static void AddField(ROOT::Experimental::RNTupleModel& model, std::vector<std::function<void()>>& copies, const std::string& name, const T* source) {
+  auto field = model.MakeField<T>(name);
+  copies.push_back([field, source]() { *field = *source; });
+}
+
+// Same for the particle columns, which are swapped with the shower
+template <typename T>
+static void AddColumnField(
+    ROOT::Experimental::RNTupleModel& model, std::vector<std::function<void()>>& copies, const std::string& name, T* const* source) {
+  auto field = model.MakeField<T>(name);
+  copies.push_back([field, source]() { *field = **source; });
+}
+
+static std::function<void()> CopyAll(std::vector<std::function<void()>> copies) {
+  return [copies = std::move(copies)]() {
+    for (const auto& copy: copies)
+      copy();
+  };
+}
+
+std::function<void()> EventData::ConnectHeaderNTuple(ROOT::Experimental::RNTupleModel& model) {
+  std::vector<std::function<void()>> copies;
+  AddField(model, copies, "EventID", &event_id);
+  AddField(model, copies, "PrimaryParticleID", &primary_particle_id);
+  AddField(model, copies, "ParticleAmount", &particle_amount);
+  AddField(model, copies, "FilteredSpecies", &filtered_species);
+  AddField(model, copies, "FilteredEnergy", &filtered_energy);
+  AddField(model, copies, "FilteredTime", &filtered_time);
+  return CopyAll(std::move(copies));
+}
+
+std::function<void()> EventData::ConnectEventNTuple(ROOT::Experimental::RNTupleModel& model, const OutputPolicy& policy) {
+  std::vector<std::function<void()>> copies;
+
+  // full precision column or its narrow copy, depending on the policy
+  auto add = [&](const char* name, const auto* full, const auto* narrow, G4bool use_narrow) {
+    if (use_narrow)
+      AddField(model, copies, name, narrow);
+    else
+      AddField(model, copies, name, full);
+  };
+
+  AddField(model, copies, "Source", &source);
+  AddField(model, copies, "EventID", &event_id);
+  AddField(model, copies, "Theta", &theta);
+  AddField(model, copies, "Phi", &phi);
+  AddField(model, copies, "ThetaReconstructed", &theta_rec);
+  AddField(model, copies, "PhiReconstructed", &phi_rec);
+  add("EnergyDeposition", &energy_dep, &narrow_.energy_dep, policy.float_precision);
+  add("ParticleCount", &particle_count, &narrow_.particle_count, policy.compact_types);
+  AddField(model, copies, "TrackLength", &track_length);
+  add("MuonCount", &muon_count, &narrow_.muon_count, policy.compact_types);
+  add("EnergyStart", &energy_start, &narrow_.energy_start, policy.float_precision);
+  add("EnergyEnd", &energy_end, &narrow_.energy_end, policy.float_precision);
+
+  // Long64_t is not a fixed width type of RNTuple
+  auto duration_field = model.MakeField<std::int64_t>("Duration");
+  copies.push_back([this, duration_field]() { *duration_field = duration; });
+
+  AddField(model, copies, "CoreX", &core_x);
+  AddField(model, copies, "CoreY", &core_y);
+  AddField(model, copies, "Rotation", &rotation);
+  add("CulledCount", &culled_count, &narrow_.culled_count, policy.compact_types);
+  add("CulledEnergy", &culled_energy, &narrow_.culled_energy, policy.float_precision);
+
+  if (policy.sparse) {
+    AddField(model, copies, "DECORChannel", &sparse_decor.channel);
+    add("DECORValue", &sparse_decor.value, &narrow_.decor, policy.compact_types);
+    AddField(model, copies, "DECORWChannel", &sparse_decor_w.channel);
+    add("DECORWValue", &sparse_decor_w.value, &narrow_.decor_w, policy.compact_types);
+    AddField(model, copies, "SCTChannel", &sparse_sct.channel);
+    add("SCTValue", &sparse_sct.value, &narrow_.sct, policy.float_precision);
+    AddField(model, copies, "CherenkovWDChannel", &sparse_qsm.channel);
+    add("CherenkovWDValue", &sparse_qsm.value, &narrow_.qsm, policy.float_precision);
+  } else {
+    add("DECOR", &muon_decor.data, &narrow_.decor, policy.compact_types);
+    add("DECORW", &muon_decor_w.data, &narrow_.decor_w, policy.compact_types);
+    add("SCT", &edep_count_sct.data, &narrow_.sct, policy.float_precision);
+    add("CherenkovWD", &amplitude_qsm.data, &narrow_.qsm, policy.float_precision);
+  }
+
+  AddColumnField(model, copies, "ParticleID", &particle_id_column_);
+  AddColumnField(model, copies, "ParticleNum", &particle_num_column_);
+  AddColumnField(model, copies, "CoordinateX", &x_column_);
+  AddColumnField(model, copies, "CoordinateY", &y_column_);
+  AddColumnField(model, copies, "CoordinateZ", &z_column_);
+  AddColumnField(model, copies, "MomentumX", &px_column_);
+  AddColumnField(model, copies, "MomentumY", &py_column_);
+  AddColumnField(model, copies, "MomentumZ", &pz_column_);
+  AddColumnField(model, copies, "Energy", &energy_column_);
+  return CopyAll(std::move(copies));
+}
+#endif
+
+void EventData::PrepareOutput(const OutputPolicy& policy) {
+  // sparse values replace the dense arrays, the narrow vectors keep their storage between events
+  const auto& decor = policy.sparse ? sparse_decor.value : muon_decor.data;
+  const auto& decor_w = policy.sparse ? sparse_decor_w.value : muon_decor_w.data;
+  const auto& sct = policy.sparse ? sparse_sct.value : edep_count_sct.data;
+  const auto& qsm = policy.sparse ? sparse_qsm.value : amplitude_qsm.data;
+
+  if (policy.compact_types) {
+    narrow_.particle_count = particle_count;
+    narrow_.muon_count = muon_count;
+    narrow_.culled_count = culled_count;
+    narrow_.decor.assign(decor.begin(), decor.end());
+    narrow_.decor_w.assign(decor_w.begin(), decor_w.end());
+  }
+
+  if (policy.float_precision) {
+    narrow_.energy_dep = energy_dep;
+    narrow_.energy_start = energy_start;
+    narrow_.energy_end = energy_end;
+    narrow_.culled_energy = culled_energy;
+    narrow_.sct.assign(sct.begin(), sct.end());
+    narrow_.qsm.assign(qsm.begin(), qsm.end());
+  }
+}
+
+G4int OutputPolicy::GetCompressionSettings() const {
+  using Algorithm = ROOT::RCompressionSetting::EAlgorithm;
+
+  if (compression == "default") return -1;
+  if (compression == "none") return 0;
+
+  static const std::map<std::string, Algorithm::EValues> algorithms = {
+      {"zlib", Algorithm::kZLIB}, {"lzma", Algorithm::kLZMA}, {"lz4", Algorithm::kLZ4}, {"zstd", Algorithm::kZSTD}};
+  auto found = algorithms.find(compression);
+  if (found == algorithms.end()) throw std::invalid_argument("Unknown compression algorithm: " + compression);
+
+  return ROOT::CompressionSettings(found->second, compression_level);
+}
+
+std::string OutputPolicy::Describe() const {
+  std::string level = compression == "default" || compression == "none" ? "" : ":" + std::to_string(compression_level);
+  return "compression=" + compression + level + " sparse=" + std::to_string(sparse) + " compact_types=" + std::to_string(compact_types) +
+         " float_precision=" + std::to_string(float_precision);
 }
 
 void EventData::Print() const { operator<<(G4cout); }
@@ -108,6 +380,14 @@ std::ostream& EventData::operator<<(std::ostream& os) const {
   return os;
 }
 
+void EventData::Allocate(const EventLayout& layout) {
+  edep_count_sct.Resize(layout.sct);
+  muon_decor.Resize(layout.decor);
+  muon_decor_w.Resize(layout.decor);
+  amplitude_qsm.Resize(layout.qsm);
+  photoelectron_num.assign(layout.pmt_num, 0);
+}
+
 void EventData::Clear(G4bool clear_header) {
   if (clear_header) {
     event_id = 0;
@@ -115,8 +395,16 @@ void EventData::Clear(G4bool clear_header) {
     particle_amount = 0;
     theta = 0;
     phi = 0;
+    culled_count = 0;
+    culled_energy = 0;
+    core_x = 0;
+    core_y = 0;
+    rotation = 0;
+    filtered_species = 0;
+    filtered_energy = 0;
+    filtered_time = 0;
+    SetShower(nullptr);
   }
-  particles.clear();
   theta_rec = 0;
   phi_rec = 0;
   energy_dep = 0;
@@ -128,11 +416,54 @@ void EventData::Clear(G4bool clear_header) {
   start_time = std::chrono::steady_clock::now();
   duration = 0;
   muon_nevod = std::make_pair(TrackData(), TrackData());
-  muon_decor = init_vector3d<Double_t>(0, 0, 0, 0);
-  muon_decor_w = init_vector3d<Double_t>(0, 0, 0, 0);
-  edep_count_sct = init_vector3d<Double_t>(0, 0, 0, 0);
-  photoelectron_num.clear();
-  amplitude_qsm = init_vector4d<Double_t>(0, 0, 0, 0, 0);
+  muon_decor.Zero();
+  muon_decor_w.Zero();
+  edep_count_sct.Zero();
+  std::fill(photoelectron_num.begin(), photoelectron_num.end(), 0);
+  amplitude_qsm.Zero();
+}
+
+void EventData::Accumulate(const EventData& other) {
+  // element-wise reduction of equally shaped detector arrays, an empty side takes the other one
+  auto reduce = [](auto& into, const auto& from, auto op) {
+    if (into.empty()) {
+      into = from;
+      return;
+    }
+    for (size_t i = 0; i < std::min(into.size(), from.size()); ++i)
+      into.data[i] = op(into.data[i], from.data[i]);
+  };
+  auto sum = [](auto a, auto b) { return a + b; };
+  auto hit = [](auto a, auto b) { return std::max(a, b); };
+
+  culled_count += other.culled_count;
+  culled_energy += other.culled_energy;
+  energy_dep += other.energy_dep;
+  particle_count += other.particle_count;
+
+  reduce(edep_count_sct, other.edep_count_sct, sum);
+  reduce(muon_decor, other.muon_decor, hit);
+  reduce(muon_decor_w, other.muon_decor_w, hit);
+
+  if (photoelectron_num.empty())
+    photoelectron_num = other.photoelectron_num;
+  else
+    for (size_t i = 0; i < std::min(photoelectron_num.size(), other.photoelectron_num.size()); ++i)
+      photoelectron_num[i] += other.photoelectron_num[i];
+
+  // muon track is kept from the chunk that saw the most of it
+  auto track_points = [](const std::pair<TrackData, TrackData>& track) {
+    return (track.first.detected_copy_num >= 0) + (track.second.detected_copy_num >= 0);
+  };
+  if (track_points(other.muon_nevod) > track_points(muon_nevod)) muon_nevod = other.muon_nevod;
+
+  if (theta_rec == 0 && phi_rec == 0) {
+    theta_rec = other.theta_rec;
+    phi_rec = other.phi_rec;
+  }
+
+  // chunks run side by side, the event takes as long as the slowest one
+  duration = std::max(duration, other.duration);
 }
 
 }  // namespace nevod
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "control/FileScheduler.hh"
+
+namespace nevod {
+
+void FileScheduler::Reset(const std::vector<size_t>& order, size_t lane_num, size_t lease_size) {
+  order_ = order;
+  lease_size_ = std::max<size_t>(lease_size, 1);
+
+  lanes_.clear();
+  for (size_t i = 0; i < std::max<size_t>(lane_num, 1); ++i)
+    lanes_.push_back(std::make_unique<Lane>());
+
+  size_t file_num = order_.empty() ? 0 : *std::max_element(order_.begin(), order_.end()) + 1;
+  dropped_ = std::make_unique<std::atomic<G4bool>[]>(file_num);
+  for (size_t i = 0; i < file_num; ++i)
+    dropped_[i] = false;
+  live_num_ = order_.size();
+
+  // generations are unique across instances, so a scheduler at the address of a destroyed one starts clean
+  static std::atomic<size_t> next_generation{1};
+  generation_ = next_generation++;
+  lane_counter_ = 0;
+
+  next_ = 0;
+}
+
+G4bool FileScheduler::Next(size_t& file) {
+  Lane& lane = *lanes_[GetLane()];
+
+  while (true) {
+    {
+      G4AutoLock lock(&lane.mutex);
+      if (!lane.files.empty()) {
+        file = lane.files.front();
+        lane.files.pop_front();
+        if (!dropped_[file]) return true;
+        continue;
+      }
+    }
+
+    if (Lease(lane) || Steal(lane)) continue;
+
+    // every file is handed out, the run simulates each of them once
+    return false;
+  }
+}
+
+G4bool FileScheduler::Drop(size_t file) {
+  if (dropped_[file].exchange(true)) return false;
+  live_num_--;
+  return true;
+}
+
+size_t FileScheduler::GetLiveNumber() const { return live_num_; }
+
+size_t FileScheduler::GetLane() {
+  struct Assignment {
+    size_t generation = 0;
+    size_t lane = 0;
+  };
+
+  // threads get lanes in order of their first request to this scheduler since its last Reset
+  static thread_local std::map<const FileScheduler*, Assignment> assignments;
+  Assignment& assignment = assignments[this];
+  if (assignment.generation != generation_) assignment = {generation_, lane_counter_++};
+  return assignment.lane % lanes_.size();
+}
+
+G4bool FileScheduler::Lease(Lane& lane) {
+  size_t start = next_.fetch_add(lease_size_);
+  if (start >= order_.size()) return false;
+
+  size_t end = std::min(start + lease_size_, order_.size());
+
+  G4AutoLock lock(&lane.mutex);
+  lane.files.insert(lane.files.end(), order_.begin() + start, order_.begin() + end);
+  return true;
+}
+
+G4bool FileScheduler::Steal(Lane& thief) {
+  for (auto& victim: lanes_) {
+    if (victim.get() == &thief) continue;
+
+    std::deque<size_t> stolen;
+    {
+      G4AutoLock lock(&victim->mutex);
+      size_t count = (victim->files.size() + 1) / 2;
+      for (size_t i = 0; i < count; ++i) {
+        stolen.push_front(victim->files.back());
+        victim->files.pop_back();
+      }
+    }
+
+    if (!stolen.empty()) {
+      G4AutoLock lock(&thief.mutex);
+      thief.files.insert(thief.files.end(), stolen.begin(), stolen.end());
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace nevod
\ No newline at end of file
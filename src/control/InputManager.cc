@@ -5,53 +5,153 @@ namespace nevod {
 DataFile::DataFile(G4String data_dir_name, G4String dataset_name, G4int event_num)
     : data_dir_name(data_dir_name), dataset_name(dataset_name), event_num(event_num) {}
 
-G4String DataFile::GetFileName() { return data_dir_name + "/" + dataset_name + "_" + std::to_string(event_num) + ".root"; }
+DataFile DataFile::FromPath(const fs::path& path) {
+  std::string file_name = path.stem().string();
+  DataFile file(path.parent_path().string(), file_name.substr(0, file_name.find_last_of("_")), std::stoi(file_name.substr(file_name.find_last_of("_") + 1)));
+  file.extension = path.extension().string();
+  return file;
+}
+
+G4bool DataFile::HasEventNumber(const fs::path& path) {
+  std::string file_name = path.stem().string();
+  auto separator = file_name.find_last_of("_");
+  if (separator == std::string::npos) return false;
+
+  std::string event_num = file_name.substr(separator + 1);
+  // longer numbers overflow the G4int
+  return !event_num.empty() && event_num.size() < 10 && std::all_of(event_num.begin(), event_num.end(), [](unsigned char c) { return std::isdigit(c); });
+}
 
-InputManager::InputManager(Communicator* communicator, size_t offset): communicator_(communicator), offset_(offset) {
+G4String DataFile::GetFileName() { return GetKey() + extension; }
+
+G4String DataFile::GetKey() const { return data_dir_name + "/" + dataset_name + "_" + std::to_string(event_num); }
+
+// native files sort before ROOT ones, so deduplication keeps the converted copy
+G4String DataFile::GetUnitKey() const {
+  std::string name = dataset_name + "_" + std::to_string(event_num);
+  return relative_dir_name.empty() ? name : relative_dir_name + "/" + name;
+}
+
+G4bool DataFile::operator<(const DataFile& other) const {
+  return std::tie(data_dir_name, dataset_name, event_num, extension) <
+         std::tie(other.data_dir_name, other.dataset_name, other.event_num, other.extension);
+}
+
+G4bool DataFile::operator==(const DataFile& other) const {
+  return data_dir_name == other.data_dir_name && dataset_name == other.dataset_name && event_num == other.event_num;
+}
+
+InputManager::InputManager(Communicator* communicator, size_t offset)
+    : communicator_(communicator), offset_(offset), store_(size_t(communicator->GetSimulationParams().shower_store_size) * 1024 * 1024),
+      splitter_(communicator->GetSimulationParams().input_stream_path.empty() ? communicator->GetSimulationParams().split_threshold : 0,
+                communicator->GetSimulationParams().split_chunk_num) {
   auto params = communicator_->GetSimulationParams();
   path_ = params.input_path;
   thread_num_ = params.thread_num;
+  discovery_thread_num_ = params.discovery_thread_num;
+  prefetch_depth_ = params.prefetch_depth;
+  io_thread_num_ = params.io_thread_num;
+  lease_size_ = params.lease_size;
 
-  current_file_id = 0;
-  DetectFiles(path_);
+  // stream sizes are not known ahead, so its showers are never split
+  if (!params.input_stream_path.empty()) {
+    stream_ = new ShowerStream(params.input_stream_path);
+    stream_shower_num_ = params.stream_shower_num;
+  }
+}
+
+InputManager::~InputManager() {
+  StopPrefetch();
+  store_.PrintStatistics();
+  delete stream_;
 }
 
 void InputManager::DetectFiles(std::string path) {
-  G4cout << "Detecting files in " << path << G4endl;
+  LOG_INFO("Detecting files in " << path);
 
+  // directory walk is cheap, opening the files is not
+  std::vector<fs::path> candidates;
   for (const auto& entry: fs::recursive_directory_iterator(path)) {
-    if (entry.is_regular_file()) {
-      std::string file_name = entry.path().filename().string();
-
-      if (file_name.find(".root") != std::string::npos) {
-        // check root files
-        auto file = TFile::Open(entry.path().string().c_str(), "READ");
-        if (!file || file->IsZombie()) {
-          G4cerr << "Error opening file " << entry.path().string() << " (zombie file)" << G4endl;
-          file->Close();
-          delete file;
-          continue;
-        } else if (file->GetNkeys() == 0) {
-          G4cerr << "Error opening file " << entry.path().string() << " (empty file)" << G4endl;
-          file->Close();
-          delete file;
-          continue;
-        }
-        file->Close();
-        delete file;
-
-        // add file to the list
-        std::string data_dir_name = entry.path().parent_path().string();
-        std::string dataset_name = file_name.substr(0, file_name.find_last_of("_"));
-        G4int event_num = std::stoi(file_name.substr(file_name.find_last_of("_") + 1, file_name.find(".root") - file_name.find_last_of("_") - 1));
-        files_.push_back(DataFile(data_dir_name, dataset_name, event_num));
+    if (!entry.is_regular_file()) continue;
+    if (entry.path().extension() != ".root" && entry.path().extension() != SHOWER_FILE_EXTENSION) continue;
+
+    if (!DataFile::HasEventNumber(entry.path())) {
+      LOG_WARNING("Skipping " << entry.path().string() << ", the name has no _<event number> suffix");
+      continue;
+    }
+    candidates.push_back(entry.path());
+  }
+
+  InputManifest manifest(path);
+  manifest.Load();
+
+  // check input files in parallel (only new or modified ones are opened)
+  std::vector<ManifestEntry> checked(candidates.size());
+  std::atomic<size_t> next_candidate{0};
+
+  auto validate = [&]() {
+    for (size_t i = next_candidate++; i < candidates.size(); i = next_candidate++) {
+      // an exception would terminate the helper thread, so a file that vanished or cannot be stat'ed is just invalid
+      try {
+        checked[i] = manifest.Validate(candidates[i]);
+      } catch (const std::exception& error) {
+        LOG_WARNING("Error validating file " << candidates[i].string() << " (" << error.what() << ")");
+        checked[i].valid = false;
       }
     }
+  };
+
+  size_t worker_num = std::min<size_t>(std::max(discovery_thread_num_, 1), candidates.size());
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < worker_num; ++i)
+    workers.emplace_back(validate);
+  validate();
+  for (auto& worker: workers)
+    worker.join();
+
+  manifest.Save();
+
+  // checkpoint keys do not depend on the spelling of the input path
+  fs::path input_root = fs::weakly_canonical(path);
+
+  files_.clear();
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (!checked[i].valid) continue;
+
+    // add file to the list
+    files_.push_back(DataFile::FromPath(candidates[i]));
+    files_.back().particle_num = checked[i].particle_num;
+
+    fs::path relative_dir = fs::weakly_canonical(candidates[i].parent_path()).lexically_relative(input_root);
+    files_.back().relative_dir_name = relative_dir == "." ? "" : relative_dir.generic_string();
   }
 
+  // stable order, independent of directory iteration and thread timing
+  std::sort(files_.begin(), files_.end());
+  files_.erase(std::unique(files_.begin(), files_.end()), files_.end());
+
+  files_.erase(files_.begin(), files_.begin() + std::min(offset_, files_.size()));
+
+  // files with every epoch in the checkpoints are done
+  const Checkpoint& checkpoint = communicator_->GetCheckpoint();
+  G4int epoch_num = communicator_->GetTotalEpochNum();
+  files_.erase(std::remove_if(files_.begin(), files_.end(), [&](const DataFile& file) { return checkpoint.GetDoneNumber(file.GetUnitKey(), epoch_num) >= epoch_num; }),
+               files_.end());
+
   files_num_ = files_.size();
 
-  G4cout << "Found " << files_num_ << " files" << G4endl;
+  // heaviest showers go first, so the light ones fill the gaps at the end of the run
+  std::vector<size_t> order(files_num_);
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return files_[a].particle_num > files_[b].particle_num; });
+
+  // one lane per thread reading files; with prefetch these are the few I/O threads, so stealing
+  // only evens out their leases and the workers are balanced by the shared ready queue instead
+  G4int lane_num = (prefetch_depth_ > 0 && io_thread_num_ > 0) ? io_thread_num_ : thread_num_;
+  scheduler_.Reset(order, lane_num, lease_size_);
+
+  LOG_INFO("Found " << files_num_ << " files (" << worker_num << " validation threads)");
 }
 
 G4int InputManager::GetFilesNumber() {
@@ -59,25 +159,247 @@ G4int InputManager::GetFilesNumber() {
   return files_num_;
 }
 
-std::vector<DataFile> InputManager::GetNextFiles(const G4int files_num) {
+G4int InputManager::GetEventNumber(const G4int epoch_num) {
+  if (stream_) return epoch_num * stream_shower_num_;
+
   G4AutoLock lock(&mutex_);
-  G4int start = current_file_id;
-  G4int end = (start + files_num >= files_num_) ? files_num_ : start + files_num;
+  G4int event_num = 0;
+  size_t unit_num = 0;
+  const Checkpoint& checkpoint = communicator_->GetCheckpoint();
+  for (const auto& file: files_) {
+    event_num += GetFileEventNumber(file, epoch_num);
+    unit_num += epoch_num - checkpoint.GetDoneNumber(file.GetUnitKey(), epoch_num);
+  }
+  event_num_ = event_num;
+  unit_num_ = unit_num;
+  return event_num;
+}
+
+size_t InputManager::GetUnitNumber() const { return unit_num_; }
 
+G4int InputManager::GetFileEventNumber(const DataFile& file, const G4int epoch_num) const {
+  const Checkpoint& checkpoint = communicator_->GetCheckpoint();
+  return (epoch_num - checkpoint.GetDoneNumber(file.GetUnitKey(), epoch_num)) * splitter_.GetChunkNumber(file.particle_num);
+}
+
+ShowerSplitter& InputManager::GetSplitter() { return splitter_; }
+
+std::vector<DataFile> InputManager::GetNextFiles(const G4int files_num) {
   std::vector<DataFile> files;
-  for (G4int i = start; i < end; ++i) {
+  for (G4int i = 0; i < std::min(files_num, files_num_); ++i) {
     files.push_back(GetNextFile());
   }
 
-  current_file_id = (end == files_num_) ? 0 : end;
-
   return files;
 }
 
 DataFile& InputManager::GetNextFile() {
-  G4AutoLock lock(&mutex_);
-  if (current_file_id >= files_num_) { current_file_id = 0; }
-  return files_[current_file_id++];
+  size_t index = 0;
+  if (!scheduler_.Next(index)) throw std::runtime_error("No readable input files left");
+  return files_[index];
+}
+
+ShowerPtr InputManager::GetNextShower() {
+  if (prefetch_depth_ <= 0 || io_thread_num_ <= 0) {
+    try {
+      return ReadNextShower();
+    } catch (const std::exception& error) {
+      // a broken stream cannot be resynchronised
+      LOG_ERROR(error.what());
+      input_error_ = true;
+      return nullptr;
+    }
+  }
+
+  std::call_once(prefetch_started_, &InputManager::StartPrefetch, this);
+
+  G4AutoLock lock(&prefetch_mutex_);
+  // a shower being decoded may still come after another I/O thread ran out of input
+  shower_ready_.wait(lock, [this] { return !ready_showers_.empty() || (input_ended_ && decoding_showers_ == 0); });
+  if (ready_showers_.empty()) return nullptr;
+
+  ShowerPtr shower = std::move(ready_showers_.front());
+  ready_showers_.pop_front();
+  slot_free_.notify_one();
+
+  return shower;
+}
+
+G4bool InputManager::IsStreaming() const { return stream_ != nullptr; }
+
+G4bool InputManager::HasInputError() const { return input_error_; }
+
+G4int InputManager::GetFailedFileNumber() const { return failed_file_num_; }
+
+ShowerPtr InputManager::LoadShower(DataFile& file) { return store_.Get(file, &InputManager::ReadShower); }
+
+ShowerPtr InputManager::ReadNextShower() {
+  // stream showers are read once, so they bypass the store
+  if (stream_) return stream_->Next();
+
+  size_t index = 0;
+  while (scheduler_.Next(index)) {
+    try {
+      return LoadShower(files_[index]);
+    } catch (const std::exception& error) {
+      DropFile(index, error.what());
+    }
+  }
+
+  // every file is taken, the input failed when none of them could be read
+  if (scheduler_.GetLiveNumber() == 0) input_error_ = true;
+  return nullptr;
+}
+
+void InputManager::DropFile(size_t index, const std::string& error) {
+  // the counts below change once per file
+  if (!scheduler_.Drop(index)) return;
+
+  const DataFile& file = files_[index];
+  G4int epoch_num = communicator_->GetTotalEpochNum();
+  G4int event_num = GetFileEventNumber(file, epoch_num);
+  failed_file_num_++;
+  unit_num_ -= epoch_num - communicator_->GetCheckpoint().GetDoneNumber(file.GetUnitKey(), epoch_num);
+  communicator_->SetTotalEventCount(event_num_ -= event_num);
+
+  LOG_ERROR("Dropping input file " << file.GetKey() << ", " << event_num << " events will not be simulated: " << error);
+}
+
+ShowerPtr InputManager::ReadShower(DataFile& file) {
+  if (file.extension == SHOWER_FILE_EXTENSION) return MapShowerFile(file.GetFileName(), file.GetUnitKey());
+
+  std::unique_ptr<TFile> input_file(TFile::Open(file.GetFileName().c_str(), "READ"));
+  if (!input_file || input_file->IsZombie()) throw std::runtime_error("Cannot open input file: " + file.GetFileName());
+
+  // the manifest knows only size and mtime, so a listed file may still lack its trees
+  auto header_tree = input_file->Get<TTree>("HeaderTree");
+  auto particles_tree = input_file->Get<TTree>("ParticlesTree");
+  if (!header_tree || !particles_tree) throw std::runtime_error("Input file has no shower trees: " + file.GetFileName());
+
+  auto shower = std::make_shared<Shower>();
+  shower->source = file.GetUnitKey();
+
+  header_tree->SetBranchAddress("EventID", &shower->event_id);
+  header_tree->SetBranchAddress("PrimaryParticleID", &shower->primary_particle_id);
+  header_tree->SetBranchAddress("ParticleAmount", &shower->particle_amount);
+  header_tree->SetBranchAddress("Theta", &shower->theta);
+  header_tree->SetBranchAddress("Phi", &shower->phi);
+  header_tree->GetEntry(0);
+
+  // all five columns are read anyway, so let the cache fetch whole baskets in one go
+  particles_tree->SetCacheSize(PARTICLES_CACHE_SIZE);
+  particles_tree->AddBranchToCache("*", true);
+  particles_tree->StopCacheLearningPhase();
+
+  ULong_t particle_id{}, particle_num{};
+  TVector3* coordinate = nullptr;
+  TVector3* momentum = nullptr;
+  Double_t energy{};
+
+  // bind every branch once, entries are unpacked straight into the columns
+  TBranch* id_branch = nullptr;
+  TBranch* num_branch = nullptr;
+  TBranch* coordinate_branch = nullptr;
+  TBranch* momentum_branch = nullptr;
+  TBranch* energy_branch = nullptr;
+  particles_tree->SetBranchAddress("ParticleID", &particle_id, &id_branch);
+  particles_tree->SetBranchAddress("ParticleNum", &particle_num, &num_branch);
+  particles_tree->SetBranchAddress("Coordinate", &coordinate, &coordinate_branch);
+  particles_tree->SetBranchAddress("Momentum", &momentum, &momentum_branch);
+  particles_tree->SetBranchAddress("Energy", &energy, &energy_branch);
+  if (!id_branch || !num_branch || !coordinate_branch || !momentum_branch || !energy_branch)
+    throw std::runtime_error("Input file has incomplete particle branches: " + file.GetFileName());
+
+  Long64_t entries = particles_tree->GetEntries();
+  Particles& particles = shower->particles;
+  particles.resize(entries);
+
+  for (Long64_t i = 0; i < entries; ++i) {
+    Long64_t local_entry = particles_tree->LoadTree(i);
+    id_branch->GetEntry(local_entry);
+    num_branch->GetEntry(local_entry);
+    coordinate_branch->GetEntry(local_entry);
+    momentum_branch->GetEntry(local_entry);
+    energy_branch->GetEntry(local_entry);
+
+    particles.particle_id[i] = particle_id;
+    particles.particle_num[i] = particle_num;
+    particles.x[i] = coordinate->X();
+    particles.y[i] = coordinate->Y();
+    particles.z[i] = coordinate->Z();
+    particles.px[i] = momentum->X();
+    particles.py[i] = momentum->Y();
+    particles.pz[i] = momentum->Z();
+    particles.energy[i] = energy;
+  }
+
+  // vectors were allocated by ROOT on the first read and belong to us
+  particles_tree->ResetBranchAddresses();
+  delete coordinate;
+  delete momentum;
+
+  input_file->Close();
+
+  shower->BindView();
+
+  return shower;
+}
+
+void InputManager::StartPrefetch() {
+  LOG_INFO("Prefetching " << prefetch_depth_ << " showers with " << io_thread_num_ << " I/O threads");
+
+  for (G4int i = 0; i < io_thread_num_; ++i)
+    io_threads_.emplace_back(&InputManager::PrefetchLoop, this);
+}
+
+void InputManager::StopPrefetch() {
+  {
+    G4AutoLock lock(&prefetch_mutex_);
+    stop_prefetch_ = true;
+  }
+  slot_free_.notify_all();
+
+  for (auto& thread: io_threads_)
+    thread.join();
+  io_threads_.clear();
+}
+
+void InputManager::PrefetchLoop() {
+  while (true) {
+    {
+      // reserve the slot before decoding, so the queue never grows past the depth
+      G4AutoLock lock(&prefetch_mutex_);
+      slot_free_.wait(lock, [this] { return stop_prefetch_ || ready_showers_.size() + decoding_showers_ < static_cast<size_t>(prefetch_depth_); });
+      if (stop_prefetch_) return;
+      decoding_showers_++;
+    }
+
+    // failing files are dropped inside, only a broken stream throws here
+    ShowerPtr shower = nullptr;
+    try {
+      shower = ReadNextShower();
+    } catch (const std::exception& error) {
+      // a broken stream cannot be resynchronised
+      LOG_ERROR(error.what());
+      input_error_ = true;
+    }
+
+    G4AutoLock lock(&prefetch_mutex_);
+    decoding_showers_--;
+    if (stop_prefetch_) return;
+    if (shower) {
+      ready_showers_.push_back(std::move(shower));
+      if (input_ended_)
+        shower_ready_.notify_all();
+      else
+        shower_ready_.notify_one();
+    } else {
+      // workers waiting for a shower see the end once the other I/O threads are done
+      input_ended_ = true;
+      shower_ready_.notify_all();
+      return;
+    }
+  }
 }
 
 }  // namespace nevod
\ No newline at end of file
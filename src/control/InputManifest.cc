@@ -0,0 +1,143 @@
+#include "control/InputManifest.hh"
+
+namespace nevod {
+
+InputManifest::InputManifest(const std::string& input_path) {
+  fs::path input_dir = fs::path(input_path).lexically_normal();
+  if (!input_dir.has_filename()) input_dir = input_dir.parent_path();
+
+  manifest_path_ = input_dir.string() + ".manifest";
+}
+
+void InputManifest::Load() {
+  std::ifstream manifest(manifest_path_);
+  if (!manifest.is_open()) return;
+
+  std::string line;
+  while (std::getline(manifest, line)) {
+    if (line.empty() || line[0] == '#') continue;
+
+    std::istringstream fields(line);
+    ManifestEntry entry;
+    if (std::getline(fields, entry.path, '\t') &&
+        fields >> entry.size >> entry.mtime >> entry.entry_num >> entry.particle_num >> entry.total_energy >> entry.valid)
+      entries_[entry.path] = entry;
+  }
+
+  LOG_INFO("Loaded " << entries_.size() << " entries from manifest " << manifest_path_);
+}
+
+void InputManifest::Save() {
+  if (!changed_) return;
+
+  // write aside and rename, so an interrupted run never leaves a truncated manifest
+  std::string temp_path = manifest_path_ + ".tmp";
+  {
+    std::ofstream manifest(temp_path, std::ios::trunc);
+    if (!manifest.is_open()) {
+      LOG_WARNING("Cannot write manifest " << manifest_path_);
+      return;
+    }
+
+    manifest << "# path\tsize\tmtime\tentry_num\tparticle_num\ttotal_energy\tvalid\n";
+    manifest.precision(17);
+    for (const auto& [path, entry]: entries_)
+      manifest << entry.path << '\t' << entry.size << '\t' << entry.mtime << '\t' << entry.entry_num << '\t' << entry.particle_num << '\t'
+               << entry.total_energy << '\t' << entry.valid << '\n';
+  }
+  std::error_code error;
+  fs::rename(temp_path, manifest_path_, error);
+  if (error) {
+    LOG_WARNING("Cannot write manifest " << manifest_path_ << ": " << error.message());
+    fs::remove(temp_path, error);
+    return;
+  }
+
+  changed_ = false;
+}
+
+ManifestEntry InputManifest::Validate(const fs::path& file_path) {
+  std::string path = file_path.string();
+  std::uintmax_t size = fs::file_size(file_path);
+  Long64_t mtime = fs::last_write_time(file_path).time_since_epoch().count();
+
+  {
+    G4AutoLock lock(&mutex_);
+    auto cached = entries_.find(path);
+    if (cached != entries_.end() && cached->second.size == size && cached->second.mtime == mtime) return cached->second;
+  }
+
+  // file is opened outside the lock, so validations run in parallel
+  ManifestEntry entry = ReadEntry(file_path);
+  entry.size = size;
+  entry.mtime = mtime;
+
+  G4AutoLock lock(&mutex_);
+  changed_ = true;
+  entries_[path] = entry;
+
+  return entry;
+}
+
+ManifestEntry InputManifest::ReadEntry(const fs::path& file_path) {
+  ManifestEntry entry;
+  entry.path = file_path.string();
+
+  if (file_path.extension() == SHOWER_FILE_EXTENSION) {
+    try {
+      ShowerPtr shower = MapShowerFile(entry.path);
+      entry.entry_num = 1;
+      entry.particle_num = shower->view.size;
+      for (size_t i = 0; i < shower->view.size; ++i)
+        entry.total_energy += shower->view.energy[i];
+      entry.valid = true;
+    } catch (const std::exception& error) {
+      LOG_WARNING("Error opening file " << entry.path << " (" << error.what() << ")");
+    }
+    return entry;
+  }
+
+  auto file = TFile::Open(entry.path.c_str(), "READ");
+  if (!file || file->IsZombie()) {
+    LOG_WARNING("Error opening file " << entry.path << " (zombie file)");
+    delete file;
+    return entry;
+  } else if (file->GetNkeys() == 0) {
+    LOG_WARNING("Error opening file " << entry.path << " (empty file)");
+    file->Close();
+    delete file;
+    return entry;
+  }
+
+  auto header_tree = (TTree*)file->Get("HeaderTree");
+  auto particles_tree = (TTree*)file->Get("ParticlesTree");
+
+  if (header_tree && particles_tree) {
+    entry.entry_num = header_tree->GetEntries();
+    entry.particle_num = particles_tree->GetEntries();
+
+    Double_t energy = 0;
+    particles_tree->SetBranchStatus("*", false);
+    particles_tree->SetBranchStatus("Energy", true);
+    particles_tree->SetBranchAddress("Energy", &energy);
+    for (Long64_t i = 0; i < entry.particle_num; ++i) {
+      particles_tree->GetEntry(i);
+      entry.total_energy += energy;
+    }
+
+    entry.valid = entry.entry_num > 0;
+  } else {
+    LOG_WARNING("Error opening file " << entry.path << " (no shower trees)");
+  }
+
+  file->Close();
+  delete file;
+
+  return entry;
+}
+
+const std::string& InputManifest::GetPath() const { return manifest_path_; }
+
+size_t InputManifest::GetSize() const { return entries_.size(); }
+
+}  // namespace nevod
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "control/Logger.hh"
+
+namespace nevod {
+
+std::string LogChannel::GetName() const {
+  return thread_id >= 0 ? "worker" + std::to_string(thread_id) : "thread" + std::to_string(index);
+}
+
+Logger& Logger::Instance() {
+  static Logger logger;
+  return logger;
+}
+
+Logger::~Logger() { Stop(); }
+
+void Logger::Start(LogLevel level, G4bool save, const std::string& dir) {
+  if (thread_.joinable()) return;
+
+  save_ = save;
+  dir_ = dir;
+
+  stop_.store(false, std::memory_order_relaxed);
+  level_.store(static_cast<G4int>(level), std::memory_order_relaxed);
+  thread_ = std::thread(&Logger::Loop, this);
+}
+
+void Logger::Stop() {
+  if (!thread_.joinable()) return;
+
+  level_.store(static_cast<G4int>(LogLevel::OFF), std::memory_order_relaxed);
+  stop_.store(true, std::memory_order_release);
+  thread_.join();
+
+  G4AutoLock lock(&mutex_);
+  for (auto& channel: channels_) {
+    if (channel->file.is_open()) channel->file.close();
+    size_t dropped = channel->dropped.exchange(0);
+    if (dropped > 0) G4cerr << "Logger: " << dropped << " messages of " << channel->GetName() << " dropped, the ring was full" << G4endl;
+  }
+}
+
+LogChannel& Logger::GetChannel() {
+  // registered once per thread, the lock is not taken again by it
+  thread_local LogChannel* channel = nullptr;
+  if (channel) return *channel;
+
+  G4AutoLock lock(&mutex_);
+  channels_.push_back(std::make_unique<LogChannel>());
+  channel = channels_.back().get();
+  channel->thread_id = G4Threading::G4GetThreadId();
+  channel->index = channels_.size() - 1;
+  return *channel;
+}
+
+std::ostream* Logger::BeginLine(LogLevel level) {
+  LogChannel& channel = GetChannel();
+
+  channel.record = channel.queue.BeginPush(channel.ticket);
+  if (!channel.record) {
+    channel.dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  channel.record->level = level;
+  channel.record->time = std::chrono::steady_clock::now();
+  channel.buffer.Reset(channel.record->message, LOG_MESSAGE_SIZE);
+  channel.stream.clear();
+  return &channel.stream;
+}
+
+void Logger::EndLine() {
+  LogChannel& channel = GetChannel();
+  channel.record->message[channel.buffer.GetSize()] = '\0';
+  channel.queue.EndPush(channel.ticket);
+  channel.record = nullptr;
+}
+
+size_t Logger::Drain(LogChannel& channel) {
+  size_t count = 0;
+  while (LogRecord* record = channel.queue.BeginPop()) {
+    if (save_ && !channel.file.is_open()) channel.file.open(dir_ / (LOG_FILE_PREFIX + channel.GetName() + ".log"), std::ios::app);
+
+    G4double seconds = std::chrono::duration<G4double>(record->time - start_time_).count();
+    if (save_)
+      channel.file << seconds << " [" << GetLevelName(record->level) << "] " << record->message << '\n';
+    else
+      G4cout << seconds << " [" << GetLevelName(record->level) << "] [" << channel.GetName() << "] " << record->message << G4endl;
+
+    channel.queue.EndPop();
+    ++count;
+  }
+
+  if (count > 0 && channel.file.is_open()) channel.file.flush();
+  return count;
+}
+
+void Logger::Loop() {
+  std::vector<LogChannel*> channels;
+
+  while (true) {
+    G4bool stop = stop_.load(std::memory_order_acquire);
+
+    // threads register rarely, so the flusher takes the lock only to copy the list
+    {
+      G4AutoLock lock(&mutex_);
+      channels.clear();
+      for (auto& channel: channels_)
+        channels.push_back(channel.get());
+    }
+
+    size_t count = 0;
+    for (auto* channel: channels)
+      count += Drain(*channel);
+
+    // everything pushed before the stop is written by this last pass
+    if (stop) break;
+    if (count == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+const char* Logger::GetLevelName(LogLevel level) {
+  switch (level) {
+    case LogLevel::DEBUG:
+      return "debug";
+    case LogLevel::INFO:
+      return "info";
+    case LogLevel::WARNING:
+      return "warning";
+    case LogLevel::ERROR:
+      return "error";
+    case LogLevel::OFF:
+      return "off";
+  }
+  return "unknown";
+}
+
+LogLevel Logger::ParseLevel(const std::string& name) {
+  for (auto level: {LogLevel::DEBUG, LogLevel::INFO, LogLevel::WARNING, LogLevel::ERROR, LogLevel::OFF})
+    if (name == GetLevelName(level)) return level;
+  throw std::invalid_argument("Unknown log level: " + name);
+}
+
+}  // namespace nevod
\ No newline at end of file
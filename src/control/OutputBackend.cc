@@ -0,0 +1,86 @@
+#include "control/OutputBackend.hh"
+
+namespace nevod {
+
+TTreeBackend::TTreeBackend(EventData& data, const OutputPolicy& policy) {
+  run_header_tree_ = new TTree("RunHeaderTree", "run level data");
+  data.ConnectHeaderTree(run_header_tree_);
+
+  event_tree_ = new TTree("EventTree", "event level data");
+  event_tree_->Branch("Epoch", &epoch_, "Epoch/I");
+  data.ConnectEventTree(event_tree_, policy);
+}
+
+void TTreeBackend::FillHeader() { run_header_tree_->Fill(); }
+
+void TTreeBackend::FillEvent(G4int epoch) {
+  epoch_ = epoch;
+  event_tree_->Fill();
+}
+
+G4bool TTreeBackend::Save() {
+  // trees are saved with their baskets, so the file is readable up to here after a crash
+  run_header_tree_->AutoSave("SaveSelf");
+  event_tree_->AutoSave("SaveSelf");
+  return true;
+}
+
+void TTreeBackend::Close() {}
+
+#ifdef NEVOD_WITH_RNTUPLE
+RNTupleBackend::RNTupleBackend(TFile& file, EventData& data, const OutputPolicy& policy) {
+  // pages are compressed by the writer, not by the file
+  ROOT::Experimental::RNTupleWriteOptions options;
+  if (policy.GetCompressionSettings() >= 0) options.SetCompression(policy.GetCompressionSettings());
+
+  auto run_header_model = ROOT::Experimental::RNTupleModel::Create();
+  copy_header_ = data.ConnectHeaderNTuple(*run_header_model);
+  run_header_writer_ = ROOT::Experimental::RNTupleWriter::Append(std::move(run_header_model), "RunHeaderTree", file, options);
+
+  auto event_model = ROOT::Experimental::RNTupleModel::Create();
+  epoch_ = event_model->MakeField<G4int>("Epoch");
+  copy_event_ = data.ConnectEventNTuple(*event_model, policy);
+  event_writer_ = ROOT::Experimental::RNTupleWriter::Append(std::move(event_model), "EventTree", file, options);
+}
+
+void RNTupleBackend::FillHeader() {
+  copy_header_();
+  run_header_writer_->Fill();
+}
+
+void RNTupleBackend::FillEvent(G4int epoch) {
+  *epoch_ = epoch;
+  copy_event_();
+  event_writer_->Fill();
+}
+
+G4bool RNTupleBackend::Save() {
+  run_header_writer_->CommitCluster();
+  event_writer_->CommitCluster();
+  return false;
+}
+
+void RNTupleBackend::Close() {
+  // writers put their footers into the file when destroyed
+  run_header_writer_.reset();
+  event_writer_.reset();
+}
+#endif
+
+std::unique_ptr<OutputBackend> MakeOutputBackend(OutputFormat format, TFile& file, EventData& data, const OutputPolicy& policy) {
+  file.cd();
+
+  switch (format) {
+    case OutputFormat::TTREE:
+      return std::make_unique<TTreeBackend>(data, policy);
+    case OutputFormat::RNTUPLE:
+#ifdef NEVOD_WITH_RNTUPLE
+      return std::make_unique<RNTupleBackend>(file, data, policy);
+#else
+      throw std::invalid_argument("RNTuple output is not built, configure with -DWITH_RNTUPLE=ON and a ROOT providing ROOTNTuple");
+#endif
+  }
+  throw std::invalid_argument("Unknown output format");
+}
+
+}  // namespace nevod
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include "control/OutputMerger.hh"
+
+namespace nevod {
+
+OutputMerger::OutputMerger(const OutputMergerParams& params): params_(params) {}
+
+size_t OutputMerger::FindInputs() {
+  inputs_.clear();
+  if (!fs::exists(params_.output_dir)) return 0;
+
+  // (shard, name), shards of resumed runs follow the ones they continue
+  std::vector<std::pair<G4int, fs::path>> shards;
+  for (const auto& entry: fs::directory_iterator(params_.output_dir)) {
+    std::string name = entry.path().filename().string();
+    if (!entry.is_regular_file() || entry.path().extension() != ".root") continue;
+
+    if (name == MERGED_OUTPUT_NAME) {
+      // its shards are gone, so it is the only copy of their events
+      if (params_.delete_inputs) shards.emplace_back(-1, entry.path());
+      continue;
+    }
+    G4int shard = ParseShard(name);
+    if (shard >= 0) shards.emplace_back(shard, entry.path());
+  }
+
+  std::sort(shards.begin(), shards.end());
+  for (const auto& [shard, path]: shards)
+    inputs_.push_back(path);
+
+  return inputs_.size();
+}
+
+G4int OutputMerger::ParseShard(const std::string& name) {
+  const std::string first = std::string(OUTPUT_PREFIX) + ".root";
+  const std::string prefix = std::string(OUTPUT_PREFIX) + "_part";
+  if (name == first) return 0;
+  if (name.rfind(prefix, 0) != 0 || fs::path(name).extension() != ".root") return -1;
+
+  std::string shard = fs::path(name).stem().string().substr(prefix.size());
+  if (shard.empty() || shard.size() > 9 || !std::all_of(shard.begin(), shard.end(), [](unsigned char c) { return std::isdigit(c); })) return -1;
+  return std::stoi(shard);
+}
+
+size_t OutputMerger::RemoveOutputs(const std::string& output_dir) {
+  if (!fs::exists(output_dir)) return 0;
+
+  std::vector<fs::path> stale;
+  for (const auto& entry: fs::directory_iterator(output_dir)) {
+    std::string name = entry.path().filename().string();
+    if (entry.is_regular_file() && (name == MERGED_OUTPUT_NAME || ParseShard(name) >= 0)) stale.push_back(entry.path());
+  }
+
+  for (const auto& path: stale)
+    fs::remove(path);
+  return stale.size();
+}
+
+void OutputMerger::FastMerge(const std::vector<fs::path>& inputs, const fs::path& output, G4int compression_settings) {
+  TFileMerger merger(kFALSE, kFALSE);
+  merger.SetMsgPrefix("nevod");
+  merger.SetPrintLevel(0);
+
+  G4bool opened = compression_settings < 0 ? merger.OutputFile(output.c_str(), "RECREATE")
+                                            : merger.OutputFile(output.c_str(), "RECREATE", compression_settings);
+  if (!opened) throw std::runtime_error("Cannot write merged output: " + output.string());
+  for (const auto& input: inputs)
+    if (!merger.AddFile(input.c_str(), kFALSE)) throw std::runtime_error("Cannot read output file: " + input.string());
+
+  if (!merger.Merge()) throw std::runtime_error("Cannot merge output files into " + output.string());
+}
+
+std::vector<std::vector<OutputMerger::EventKey>> OutputMerger::ReadKeys(const std::vector<TTree*>& event_trees) {
+  std::map<std::string, Int_t> sources;
+  std::vector<std::vector<EventKey>> keys(event_trees.size());
+
+  for (size_t i = 0; i < event_trees.size(); ++i) {
+    TTree* event_tree = event_trees[i];
+
+    // only the key branches are read, shards written before the source branch sort as one file
+    std::string* source = nullptr;
+    Int_t epoch = 0;
+    Long64_t event_id = 0;
+    event_tree->SetBranchStatus("*", false);
+    event_tree->SetBranchStatus("Epoch", true);
+    event_tree->SetBranchAddress("Epoch", &epoch);
+    if (event_tree->GetBranch("EventID")) {
+      event_tree->SetBranchStatus("EventID", true);
+      event_tree->SetBranchAddress("EventID", &event_id);
+    }
+    G4bool has_source = event_tree->GetBranch("Source") != nullptr;
+    if (has_source) {
+      event_tree->SetBranchStatus("Source", true);
+      event_tree->SetBranchAddress("Source", &source);
+    }
+
+    keys[i].resize(event_tree->GetEntries());
+    for (Long64_t entry = 0; entry < Long64_t(keys[i].size()); ++entry) {
+      event_tree->GetEntry(entry);
+      auto found = sources.emplace(has_source && source ? *source : std::string(), Int_t(sources.size())).first;
+      keys[i][entry] = {found->second, epoch, event_id, entry};
+    }
+
+    event_tree->SetBranchStatus("*", true);
+    event_tree->ResetBranchAddresses();
+    delete source;
+  }
+
+  // numbers in the order of first appearance are replaced by the order of the names
+  std::vector<Int_t> rank(sources.size());
+  Int_t position = 0;
+  for (const auto& [name, number]: sources)
+    rank[number] = position++;
+  for (auto& tree_keys: keys)
+    for (auto& key: tree_keys)
+      key.source = rank[key.source];
+
+  return keys;
+}
+
+void OutputMerger::SortedCopy(const fs::path& input, const fs::path& output, G4int compression_settings) {
+  std::unique_ptr<TFile> input_file(TFile::Open(input.c_str(), "READ"));
+  if (!input_file || input_file->IsZombie()) throw std::runtime_error("Cannot read output file: " + input.string());
+
+  auto* run_header_tree = input_file->Get<TTree>("RunHeaderTree");
+  auto* event_tree = input_file->Get<TTree>("EventTree");
+  if (!run_header_tree || !event_tree) throw std::runtime_error("Output file has no trees: " + input.string());
+
+  // the entry keeps equal keys in writing order
+  std::vector<EventKey> keys = std::move(ReadKeys({event_tree}).front());
+  std::sort(keys.begin(), keys.end());
+
+  std::unique_ptr<TFile> output_file(TFile::Open(output.c_str(), "RECREATE"));
+  if (!output_file || output_file->IsZombie()) throw std::runtime_error("Cannot write merged output: " + output.string());
+  if (compression_settings >= 0) output_file->SetCompressionSettings(compression_settings);
+
+  // headers keep their order and are copied without unzipping, like the channel map and the policy
+  run_header_tree->CloneTree(-1, "fast");
+  if (auto* channel_map_tree = input_file->Get<TTree>("ChannelMapTree")) channel_map_tree->CloneTree(-1, "fast");
+  if (auto* policy = input_file->Get<TNamed>("OutputPolicy")) policy->Write();
+
+  auto* sorted_tree = event_tree->CloneTree(0);
+  for (const auto& key: keys) {
+    event_tree->GetEntry(key.entry);
+    sorted_tree->Fill();
+  }
+
+  output_file->Write();
+  output_file->Close();
+}
+
+void OutputMerger::SortedMerge(const std::vector<fs::path>& inputs, const fs::path& output, G4int compression_settings) {
+  std::vector<std::unique_ptr<TFile>> input_files;
+  std::vector<TTree*> run_header_trees, event_trees;
+  for (const auto& input: inputs) {
+    input_files.emplace_back(TFile::Open(input.c_str(), "READ"));
+    auto& input_file = input_files.back();
+    if (!input_file || input_file->IsZombie()) throw std::runtime_error("Cannot read output file: " + input.string());
+
+    run_header_trees.push_back(input_file->Get<TTree>("RunHeaderTree"));
+    event_trees.push_back(input_file->Get<TTree>("EventTree"));
+    if (!run_header_trees.back() || !event_trees.back()) throw std::runtime_error("Output file has no trees: " + input.string());
+  }
+
+  // every input is sorted already, so its keys come in order
+  std::vector<std::vector<EventKey>> keys = ReadKeys(event_trees);
+
+  std::unique_ptr<TFile> output_file(TFile::Open(output.c_str(), "RECREATE"));
+  if (!output_file || output_file->IsZombie()) throw std::runtime_error("Cannot write merged output: " + output.string());
+  if (compression_settings >= 0) output_file->SetCompressionSettings(compression_settings);
+
+  // headers follow in shard order, the channel map and the policy are the same in every shard
+  auto* run_header_tree = run_header_trees.front()->CloneTree(-1, "fast");
+  for (size_t i = 1; i < run_header_trees.size(); ++i)
+    run_header_tree->CopyEntries(run_header_trees[i], -1, "fast");
+  if (auto* channel_map_tree = input_files.front()->Get<TTree>("ChannelMapTree")) channel_map_tree->CloneTree(-1, "fast");
+  if (auto* policy = input_files.front()->Get<TNamed>("OutputPolicy")) policy->Write();
+
+  // all trees read into the buffers of one of them, which the merged tree writes from
+  size_t first = 0;
+  while (first + 1 < event_trees.size() && keys[first].empty())
+    ++first;
+  if (!keys[first].empty()) event_trees[first]->GetEntry(0);
+  auto* merged_tree = event_trees[first]->CloneTree(0);
+  for (size_t i = 0; i < event_trees.size(); ++i)
+    if (i != first) merged_tree->CopyAddresses(event_trees[i]);
+
+  // k-way merge, (key, input) of the next entry of every input, each input is read front to back
+  using Head = std::pair<EventKey, size_t>;
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+  std::vector<size_t> positions(event_trees.size(), 0);
+  for (size_t i = 0; i < event_trees.size(); ++i)
+    if (!keys[i].empty()) heads.push({keys[i].front(), i});
+
+  while (!heads.empty()) {
+    auto [key, i] = heads.top();
+    heads.pop();
+
+    event_trees[i]->GetEntry(key.entry);
+    merged_tree->Fill();
+    if (++positions[i] < keys[i].size()) heads.push({keys[i][positions[i]], i});
+  }
+
+  output_file->Write();
+  output_file->Close();
+}
+
+void OutputMerger::Merge() {
+  if (inputs_.empty()) return;
+
+  auto start_time = std::chrono::steady_clock::now();
+
+  std::uintmax_t input_size = 0;
+  for (const auto& input: inputs_)
+    input_size += fs::file_size(input);
+
+  fs::path output = fs::path(params_.output_dir) / MERGED_OUTPUT_NAME;
+  fs::path temp_output = output.string() + ".tmp";
+
+  // contiguous groups keep the shard order, every sorted shard is a group of its own and they are merged by key
+  size_t thread_num = std::max(params_.thread_num, 1);
+  size_t group_num = params_.sort ? inputs_.size() : std::min(thread_num, inputs_.size());
+
+  std::vector<fs::path> partials;
+  if (group_num == 1 && !params_.sort) {
+    partials = inputs_;
+  } else {
+    std::vector<std::vector<fs::path>> groups(group_num);
+    for (size_t i = 0; i < inputs_.size(); ++i)
+      groups[i * group_num / inputs_.size()].push_back(inputs_[i]);
+
+    for (size_t i = 0; i < group_num; ++i)
+      partials.push_back(temp_output.string() + std::to_string(i));
+
+    std::atomic<size_t> next_group{0};
+    std::exception_ptr error;
+    G4Mutex error_mutex = G4MUTEX_INITIALIZER;
+
+    auto merge_groups = [&]() {
+      try {
+        for (size_t i = next_group++; i < group_num; i = next_group++) {
+          if (params_.sort)
+            SortedCopy(groups[i].front(), partials[i], params_.compression_settings);
+          else
+            FastMerge(groups[i], partials[i], params_.compression_settings);
+        }
+      } catch (...) {
+        G4AutoLock lock(&error_mutex);
+        if (!error) error = std::current_exception();
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(thread_num, group_num); ++i)
+      workers.emplace_back(merge_groups);
+    merge_groups();
+    for (auto& worker: workers)
+      worker.join();
+
+    if (error) {
+      for (const auto& partial: partials)
+        fs::remove(partial);
+      std::rethrow_exception(error);
+    }
+  }
+
+  if (params_.sort)
+    SortedMerge(partials, temp_output, params_.compression_settings);
+  else
+    FastMerge(partials, temp_output, params_.compression_settings);
+  fs::rename(temp_output, output);
+
+  if (partials != inputs_)
+    for (const auto& partial: partials)
+      fs::remove(partial);
+
+  if (params_.delete_inputs)
+    for (const auto& input: inputs_)
+      if (input != output) fs::remove(input);
+
+  G4double seconds = std::chrono::duration<G4double>(std::chrono::steady_clock::now() - start_time).count();
+  G4double input_mb = input_size / (1024. * 1024.);
+  LOG_INFO("Merged " << inputs_.size() << " output files (" << input_mb << " MB) into " << output.string() << " in " << seconds << " s, "
+                      << input_mb / std::max(seconds, 1e-9) << " MB/s");
+}
+
+}  // namespace nevod
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include "control/OutputWriter.hh"
+
+namespace nevod {
+
+void EventRecord::Capture(const EventData& data, const EventLayout& layout) {
+  shower = data.shower;
+  filtered_species = data.filtered_species;
+  filtered_energy = data.filtered_energy;
+  filtered_time = data.filtered_time;
+
+  theta = data.theta;
+  phi = data.phi;
+  theta_rec = data.theta_rec;
+  phi_rec = data.phi_rec;
+  energy_dep = data.energy_dep;
+  particle_count = data.particle_count;
+  track_length = data.track_length;
+  muon_count = data.muon_count;
+  energy_start = data.energy_start;
+  energy_end = data.energy_end;
+  duration = data.duration;
+  core_x = data.core_x;
+  core_y = data.core_y;
+  rotation = data.rotation;
+  culled_count = data.culled_count;
+  culled_energy = data.culled_energy;
+
+  if (!event) return;
+
+  // the slot keeps its vectors, after the first few events these copies do not allocate
+  if (sparse) {
+    // zero suppression runs on the worker, so only the hit channels cross the queue
+    sparse_decor.Compress(data.muon_decor, {});
+    sparse_decor_w.Compress(data.muon_decor_w, {});
+    sparse_sct.Compress(data.edep_count_sct, layout.sct_channels);
+    sparse_qsm.Compress(data.amplitude_qsm, layout.qsm_channels);
+    return;
+  }
+
+  muon_decor.assign(data.muon_decor.data.begin(), data.muon_decor.data.end());
+  muon_decor_w.assign(data.muon_decor_w.data.begin(), data.muon_decor_w.data.end());
+  edep_count_sct.assign(data.edep_count_sct.data.begin(), data.edep_count_sct.data.end());
+  amplitude_qsm.assign(data.amplitude_qsm.data.begin(), data.amplitude_qsm.data.end());
+}
+
+void EventRecord::Restore(EventData& data) const {
+  data.filtered_species = filtered_species;
+  data.filtered_energy = filtered_energy;
+  data.filtered_time = filtered_time;
+
+  data.theta = theta;
+  data.phi = phi;
+  data.theta_rec = theta_rec;
+  data.phi_rec = phi_rec;
+  data.energy_dep = energy_dep;
+  data.particle_count = particle_count;
+  data.track_length = track_length;
+  data.muon_count = muon_count;
+  data.energy_start = energy_start;
+  data.energy_end = energy_end;
+  data.duration = duration;
+  data.core_x = core_x;
+  data.core_y = core_y;
+  data.rotation = rotation;
+  data.culled_count = culled_count;
+  data.culled_energy = culled_energy;
+
+  if (!event) return;
+
+  if (sparse) {
+    data.sparse_decor = sparse_decor;
+    data.sparse_decor_w = sparse_decor_w;
+    data.sparse_sct = sparse_sct;
+    data.sparse_qsm = sparse_qsm;
+    return;
+  }
+
+  data.muon_decor.data.assign(muon_decor.begin(), muon_decor.end());
+  data.muon_decor_w.data.assign(muon_decor_w.begin(), muon_decor_w.end());
+  data.edep_count_sct.data.assign(edep_count_sct.begin(), edep_count_sct.end());
+  data.amplitude_qsm.data.assign(amplitude_qsm.begin(), amplitude_qsm.end());
+}
+
+OutputWriter::OutputWriter(const OutputWriterParams& params): params_(params), queue_(params.queue_size) {
+  thread_ = std::thread(&OutputWriter::Loop, this);
+}
+
+OutputWriter::~OutputWriter() {
+  if (thread_.joinable()) Close();
+}
+
+void OutputWriter::Push(const EventData& data, G4int epoch, G4bool header, G4bool event) {
+  size_t ticket = 0;
+  EventRecord* record = queue_.BeginPush(ticket);
+
+  if (!record) {
+    // backpressure, the worker waits until the writer frees a slot
+    stall_num_.fetch_add(1, std::memory_order_relaxed);
+    while (!(record = queue_.BeginPush(ticket)))
+      std::this_thread::yield();
+  }
+
+  record->header = header;
+  record->event = event;
+  record->epoch = epoch;
+  record->sparse = params_.policy.sparse;
+  record->Capture(data, params_.layout);
+
+  queue_.EndPush(ticket);
+}
+
+void OutputWriter::Close() {
+  stop_.store(true, std::memory_order_release);
+  thread_.join();
+
+  LOG_INFO("Output writer: " << written_num_ << " events written, workers waited for the queue " << stall_num_.load() << " times");
+  if (duplicate_num_ > 0) LOG_ERROR("Output writer: " << duplicate_num_ << " units were simulated more than once");
+}
+
+size_t OutputWriter::GetUnitNumber() const { return unit_num_; }
+
+size_t OutputWriter::GetDuplicateNumber() const { return duplicate_num_; }
+
+void OutputWriter::BindShower(EventData& output, const ShowerPtr& shower) {
+  if (!shower || EventData::HasColumns(*shower)) {
+    output.SetShower(shower);
+    return;
+  }
+
+  auto found = bindings_.find(shower);
+  if (found == bindings_.end()) {
+    if (bindings_.size() >= std::max<size_t>(params_.binding_num, 1)) {
+      auto oldest = std::min_element(bindings_.begin(), bindings_.end(), [](const auto& a, const auto& b) { return a.second.last_use < b.second.last_use; });
+      if (oldest->first == output.shower) output.SetShower(nullptr);
+      bindings_.erase(oldest);
+    }
+
+    found = bindings_.emplace(shower, Binding()).first;
+    const ParticleView& view = shower->view;
+    Particles& columns = found->second.columns;
+    columns.particle_id.assign(view.particle_id, view.particle_id + view.size);
+    columns.particle_num.assign(view.particle_num, view.particle_num + view.size);
+    columns.x.assign(view.x, view.x + view.size);
+    columns.y.assign(view.y, view.y + view.size);
+    columns.z.assign(view.z, view.z + view.size);
+    columns.px.assign(view.px, view.px + view.size);
+    columns.py.assign(view.py, view.py + view.size);
+    columns.pz.assign(view.pz, view.pz + view.size);
+    columns.energy.assign(view.energy, view.energy + view.size);
+  }
+
+  found->second.last_use = ++binding_use_;
+  output.SetShower(shower, &found->second.columns);
+}
+
+G4bool OutputWriter::MarkWritten(const std::string& source, G4int epoch) {
+  auto& epochs = written_units_[source];
+  if (epochs.size() <= size_t(epoch)) epochs.resize(std::max<size_t>(params_.epoch_num, epoch + 1), 0);
+
+  if (epochs[epoch]) {
+    ++duplicate_num_;
+    return false;
+  }
+
+  epochs[epoch] = 1;
+  ++unit_num_;
+  return true;
+}
+
+void OutputWriter::WriteChannelMap(const EventData& data) {
+  const EventLayout& layout = params_.layout;
+
+  // index schema of the flat detector branches in EventTree (row-major), the same for every event
+  std::vector<Int_t> decor_shape = data.muon_decor.shape;
+  std::vector<Int_t> sct_shape = data.edep_count_sct.shape;
+  std::vector<Int_t> qsm_shape = data.amplitude_qsm.shape;
+
+  // indices of every channel, decoded from its dense offset
+  std::vector<Int_t> qsm_plane, qsm_stripe, qsm_module, qsm_tube;
+  for (size_t offset: layout.qsm_channels) {
+    qsm_tube.push_back(offset % layout.qsm[3]);
+    offset /= layout.qsm[3];
+    qsm_module.push_back(offset % layout.qsm[2]);
+    offset /= layout.qsm[2];
+    qsm_stripe.push_back(offset % layout.qsm[1]);
+    qsm_plane.push_back(offset / layout.qsm[1]);
+  }
+
+  std::vector<Int_t> sct_side, sct_plane, sct_row;
+  for (size_t offset: layout.sct_channels) {
+    sct_row.push_back(offset % layout.sct[2]);
+    offset /= layout.sct[2];
+    sct_plane.push_back(offset % layout.sct[1]);
+    sct_side.push_back(offset / layout.sct[1]);
+  }
+
+  // single entry per file, the channel ids of CherenkovWD and SCT index these vectors
+  auto* channel_map_tree = new TTree("ChannelMapTree", "detector channels");
+  channel_map_tree->Branch("DECORShape", &decor_shape);
+  channel_map_tree->Branch("SCTShape", &sct_shape);
+  channel_map_tree->Branch("CherenkovWDShape", &qsm_shape);
+  channel_map_tree->Branch("CherenkovWDPlane", &qsm_plane);
+  channel_map_tree->Branch("CherenkovWDStripe", &qsm_stripe);
+  channel_map_tree->Branch("CherenkovWDModule", &qsm_module);
+  channel_map_tree->Branch("CherenkovWDTube", &qsm_tube);
+  channel_map_tree->Branch("SCTSide", &sct_side);
+  channel_map_tree->Branch("SCTPlane", &sct_plane);
+  channel_map_tree->Branch("SCTRow", &sct_row);
+  channel_map_tree->Fill();
+  channel_map_tree->Write();
+  delete channel_map_tree;
+}
+
+void OutputWriter::Loop() {
+  // the file and its trees belong to this thread from creation to closing
+  auto* output_file = new TFile(params_.output_path.c_str(), "RECREATE");
+  if (params_.policy.GetCompressionSettings() >= 0) output_file->SetCompressionSettings(params_.policy.GetCompressionSettings());
+
+  // readers find out how the columns are stored
+  TNamed policy("OutputPolicy", params_.policy.Describe().c_str());
+  policy.Write();
+  CheckpointWriter checkpoint_writer(params_.checkpoint_path);
+
+  EventData output;
+  output.Allocate(params_.layout);
+
+  auto backend = MakeOutputBackend(params_.format, *output_file, output, params_.policy);
+  WriteChannelMap(output);
+
+  // time spent in the backend, to compare the formats on the same run
+  std::chrono::steady_clock::duration fill_time{};
+
+  G4int events_since_flush = 0, events_since_checkpoint = 0;
+  size_t idle_num = 0;
+
+  while (true) {
+    EventRecord* record = queue_.BeginPop();
+
+    if (!record) {
+      // workers stop pushing before Close, so an empty queue after stop is final
+      if (stop_.load(std::memory_order_acquire) && !(record = queue_.BeginPop())) break;
+
+      if (!record) {
+        if (++idle_num < 64)
+          std::this_thread::yield();
+        else
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        continue;
+      }
+    }
+    idle_num = 0;
+
+    if (output.shower != record->shower) BindShower(output, record->shower);
+    record->Restore(output);
+    auto fill_start = std::chrono::steady_clock::now();
+
+    // one header entry per shower, it keeps the filter statistics of that shower
+    if (record->header) backend->FillHeader();
+
+    // streamed showers cannot be read again, so they are neither checked nor resumable
+    const std::string& source = record->shower->source;
+    if (record->event && !source.empty() && !MarkWritten(source, record->epoch)) {
+      LOG_ERROR("Epoch " << record->epoch << " of " << source << " was simulated twice, the copy is not written");
+    } else if (record->event) {
+      output.PrepareOutput(params_.policy);
+      backend->FillEvent(record->epoch);
+      ++written_num_;
+
+      if (!source.empty()) checkpoint_writer.Add(source, record->epoch);
+
+      if (params_.checkpoint_interval > 0 && ++events_since_checkpoint >= params_.checkpoint_interval) {
+        // units are listed only once the file holding them is readable
+        G4bool durable = backend->Save();
+        output_file->Flush();
+        if (durable) checkpoint_writer.Flush();
+        events_since_checkpoint = 0;
+        events_since_flush = 0;
+      } else if (params_.flush_interval > 0 && ++events_since_flush >= params_.flush_interval) {
+        output_file->Flush();
+        events_since_flush = 0;
+      }
+    }
+
+    fill_time += std::chrono::steady_clock::now() - fill_start;
+
+    // the slot must not keep the shower alive until it is reused
+    record->shower = nullptr;
+    queue_.EndPop();
+  }
+
+  auto close_start = std::chrono::steady_clock::now();
+  backend->Close();
+  output_file->Write();
+  output_file->Close();
+  delete output_file;
+  fill_time += std::chrono::steady_clock::now() - close_start;
+
+  // everything is written now
+  checkpoint_writer.Flush();
+
+  G4double seconds = std::chrono::duration<G4double>(fill_time).count();
+  G4double size_mb = fs::file_size(params_.output_path) / (1024. * 1024.);
+  LOG_INFO("Output writer (" << backend->GetName() << "): " << size_mb << " MB written in " << seconds << " s, " << size_mb / std::max(seconds, 1e-9)
+                               << " MB/s");
+}
+
+}  // namespace nevod
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "control/ShowerFile.hh"
+
+namespace nevod {
+
+void WriteShower(std::ostream& stream, const Shower& shower) {
+  const ParticleView& particles = shower.view;
+
+  ShowerFileHeader header{};
+  std::memcpy(header.magic, SHOWER_FILE_MAGIC, sizeof(header.magic));
+  header.version = SHOWER_FILE_VERSION;
+  header.header_size = sizeof(ShowerFileHeader);
+  header.particle_count = particles.size;
+  header.event_id = shower.event_id;
+  header.primary_particle_id = shower.primary_particle_id;
+  header.particle_amount = shower.particle_amount;
+  header.theta = shower.theta;
+  header.phi = shower.phi;
+
+  stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  const void* columns[PARTICLE_COLUMN_NUM] = {
+      particles.particle_id, particles.particle_num, particles.x, particles.y, particles.z, particles.px, particles.py, particles.pz, particles.energy};
+  for (auto column: columns)
+    stream.write(static_cast<const char*>(column), particles.size * sizeof(uint64_t));
+}
+
+void WriteShowerFile(const std::string& path, const Shower& shower) {
+  // write aside and rename, so readers never map a half written file
+  std::string temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("Cannot write shower file: " + path);
+
+    WriteShower(file, shower);
+
+    if (!file) throw std::runtime_error("Cannot write shower file: " + path);
+  }
+  fs::rename(temp_path, path);
+}
+
+size_t GetShowerFileSize(const Shower& shower) { return sizeof(ShowerFileHeader) + shower.view.size * PARTICLE_COLUMN_NUM * sizeof(uint64_t); }
+
+void CheckShowerHeader(const ShowerFileHeader& header, const std::string& source) {
+  if (std::memcmp(header.magic, SHOWER_FILE_MAGIC, sizeof(header.magic)) != 0) throw std::runtime_error("Not a shower file: " + source);
+  if (header.version != SHOWER_FILE_VERSION) throw std::runtime_error("Unsupported shower file version: " + source);
+  if (header.header_size < sizeof(ShowerFileHeader) || header.header_size % sizeof(uint64_t) != 0)
+    throw std::runtime_error("Broken shower header: " + source);
+}
+
+ShowerPtr MapShowerFile(const std::string& path, const std::string& source) {
+  int descriptor = open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) throw std::runtime_error("Cannot open shower file: " + path);
+
+  struct stat file_stat;
+  if (fstat(descriptor, &file_stat) != 0 || size_t(file_stat.st_size) < sizeof(ShowerFileHeader)) {
+    close(descriptor);
+    throw std::runtime_error("Broken shower file: " + path);
+  }
+
+  size_t file_size = file_stat.st_size;
+  void* data = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  close(descriptor);
+  if (data == MAP_FAILED) throw std::runtime_error("Cannot map shower file: " + path);
+
+  std::shared_ptr<const void> mapping(data, [file_size](const void* address) { munmap(const_cast<void*>(address), file_size); });
+
+  const auto* header = static_cast<const ShowerFileHeader*>(data);
+  CheckShowerHeader(*header, path);
+  // divided instead of multiplied, a corrupt particle count must not overflow past the check
+  if (file_size < header->header_size || header->particle_count > (file_size - header->header_size) / (PARTICLE_COLUMN_NUM * sizeof(uint64_t)))
+    throw std::runtime_error("Truncated shower file: " + path);
+
+  // start reading the pages in now, so the worker thread does not fault them in
+  madvise(data, file_size, MADV_WILLNEED);
+
+  auto shower = std::make_shared<Shower>();
+  shower->source = source.empty() ? fs::path(path).replace_extension().string() : source;
+  shower->event_id = header->event_id;
+  shower->primary_particle_id = header->primary_particle_id;
+  shower->particle_amount = header->particle_amount;
+  shower->theta = header->theta;
+  shower->phi = header->phi;
+
+  size_t count = header->particle_count;
+  const auto* columns = reinterpret_cast<const uint64_t*>(static_cast<const char*>(data) + header->header_size);
+
+  ParticleView& view = shower->view;
+  view.size = count;
+  view.particle_id = reinterpret_cast<const ULong_t*>(columns);
+  view.particle_num = reinterpret_cast<const ULong_t*>(columns + count);
+  view.x = reinterpret_cast<const Double_t*>(columns + 2 * count);
+  view.y = reinterpret_cast<const Double_t*>(columns + 3 * count);
+  view.z = reinterpret_cast<const Double_t*>(columns + 4 * count);
+  view.px = reinterpret_cast<const Double_t*>(columns + 5 * count);
+  view.py = reinterpret_cast<const Double_t*>(columns + 6 * count);
+  view.pz = reinterpret_cast<const Double_t*>(columns + 7 * count);
+  view.energy = reinterpret_cast<const Double_t*>(columns + 8 * count);
+
+  shower->mapping = std::move(mapping);
+
+  return shower;
+}
+
+}  // namespace nevod
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "control/ShowerSplitter.hh"
+
+namespace nevod {
+
+SplitShower::SplitShower(ShowerPtr shower, const std::vector<uint8_t>& launch, const std::vector<G4int>& epochs, G4int chunk_num)
+    : shower(shower), launch(launch), epochs(epochs), chunk_num(chunk_num) {
+  // chunks get the same number of launched primaries, not of particles
+  size_t launch_num = 0;
+  for (uint8_t flag: launch)
+    launch_num += flag;
+
+  bounds.assign(chunk_num + 1, launch.size());
+  bounds[0] = 0;
+
+  size_t launched = 0;
+  G4int chunk = 1;
+  for (size_t i = 0; i < launch.size() && chunk < chunk_num; ++i) {
+    launched += launch[i];
+    if (launched * chunk_num >= launch_num * chunk) bounds[chunk++] = i + 1;
+  }
+}
+
+G4bool SplitShower::Reduce(G4int epoch, EventData& data) {
+  G4AutoLock lock(&mutex_);
+  auto& partial = partials_[epoch];
+
+  if (++partial.chunk_done < chunk_num) {
+    partial.response.Accumulate(data);
+    return false;
+  }
+
+  data.Accumulate(partial.response);
+  partials_.erase(epoch);
+  return true;
+}
+
+ShowerSplitter::ShowerSplitter(size_t threshold, G4int chunk_num): threshold_(threshold), chunk_num_(std::max(chunk_num, 1)) {}
+
+G4int ShowerSplitter::GetChunkNumber(size_t particle_num) const {
+  if (threshold_ == 0 || particle_num < threshold_) return 1;
+  return chunk_num_;
+}
+
+void ShowerSplitter::Post(std::shared_ptr<SplitShower> split) {
+  G4AutoLock lock(&mutex_);
+  active_.push_back(std::move(split));
+}
+
+G4bool ShowerSplitter::Next(ShowerChunk& chunk) {
+  G4AutoLock lock(&mutex_);
+
+  while (!active_.empty()) {
+    auto& split = active_.front();
+    size_t unit = split->next_unit++;
+
+    if (unit >= split->epochs.size() * split->chunk_num) {
+      // every chunk is handed out, the last ones may still be running
+      active_.pop_front();
+      continue;
+    }
+
+    chunk.split = split;
+    chunk.epoch = split->epochs[unit / split->chunk_num];
+    chunk.chunk = unit % split->chunk_num;
+    chunk.begin = split->bounds[chunk.chunk];
+    chunk.end = split->bounds[chunk.chunk + 1];
+    return true;
+  }
+
+  return false;
+}
+
+}  // namespace nevod
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "control/ShowerStore.hh"
+
+#include "control/InputManager.hh"
+
+namespace nevod {
+
+ShowerStore::ShowerStore(size_t budget_bytes): budget_bytes_(budget_bytes) {}
+
+ShowerPtr ShowerStore::Get(DataFile& file, const std::function<ShowerPtr(DataFile&)>& loader) {
+  if (budget_bytes_ == 0) return loader(file);
+
+  std::string key = file.GetFileName();
+  std::promise<ShowerPtr> promise;
+  {
+    G4AutoLock lock(&mutex_);
+    auto cached = entries_.find(key);
+    if (cached != entries_.end()) {
+      hits_++;
+      lru_.splice(lru_.begin(), lru_, cached->second.lru_position);
+      auto shower = cached->second.shower;
+      lock.unlock();
+      return shower.get();
+    }
+
+    misses_++;
+    lru_.push_front(key);
+    entries_[key] = Entry{promise.get_future().share(), 0, lru_.begin()};
+  }
+
+  // decoding runs outside the lock, other threads asking for this file wait on the future
+  ShowerPtr shower = nullptr;
+  try {
+    shower = loader(file);
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+
+    G4AutoLock lock(&mutex_);
+    auto failed = entries_.find(key);
+    if (failed != entries_.end()) {
+      lru_.erase(failed->second.lru_position);
+      entries_.erase(failed);
+    }
+    throw;
+  }
+  promise.set_value(shower);
+
+  G4AutoLock lock(&mutex_);
+  auto loaded = entries_.find(key);
+  if (loaded != entries_.end()) {
+    loaded->second.bytes = GetShowerBytes(*shower);
+    used_bytes_ += loaded->second.bytes;
+  }
+  Evict();
+
+  return shower;
+}
+
+void ShowerStore::Evict() {
+  // the most recent entry always stays, even if it alone exceeds the budget
+  while (used_bytes_ > budget_bytes_ && lru_.size() > 1) {
+    auto oldest = entries_.find(lru_.back());
+    used_bytes_ -= oldest->second.bytes;
+    entries_.erase(oldest);
+    lru_.pop_back();
+  }
+}
+
+void ShowerStore::PrintStatistics() {
+  G4AutoLock lock(&mutex_);
+  if (budget_bytes_ == 0) return;
+
+  LOG_INFO("Shower store: " << hits_ << " hits, " << misses_ << " misses, " << entries_.size() << " showers (" << used_bytes_ / (1024 * 1024) << " of "
+                            << budget_bytes_ / (1024 * 1024) << " MB)");
+}
+
+size_t ShowerStore::GetShowerBytes(const Shower& shower) {
+  // mapped showers are counted too, their pages stay resident while cached
+  return sizeof(Shower) + shower.view.size * PARTICLE_COLUMN_NUM * sizeof(Double_t);
+}
+
+}  // namespace nevod
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "control/ShowerStream.hh"
+
+namespace nevod {
+
+ShowerStream::ShowerStream(const std::string& path): path_(path) {}
+
+ShowerStream::~ShowerStream() {
+  if (descriptor_ >= 0) close(descriptor_);
+}
+
+void ShowerStream::Open() {
+  struct stat path_stat;
+  if (stat(path_.c_str(), &path_stat) != 0) throw std::runtime_error("Shower stream does not exist: " + path_);
+
+  if (S_ISSOCK(path_stat.st_mode)) {
+    sockaddr_un address{};
+    if (path_.size() >= sizeof(address.sun_path)) throw std::runtime_error("Shower socket path is too long: " + path_);
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path_.c_str(), sizeof(address.sun_path) - 1);
+
+    descriptor_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (descriptor_ >= 0 && connect(descriptor_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+      close(descriptor_);
+      descriptor_ = -1;
+    }
+  } else {
+    // blocks until the producer opens the FIFO for writing
+    descriptor_ = open(path_.c_str(), O_RDONLY);
+  }
+
+  if (descriptor_ < 0) throw std::runtime_error("Cannot open shower stream: " + path_ + " (" + std::strerror(errno) + ")");
+
+  LOG_INFO("Reading showers from " << path_);
+}
+
+G4bool ShowerStream::ReadExact(void* buffer, size_t size) {
+  auto* position = static_cast<char*>(buffer);
+  size_t done = 0;
+
+  while (done < size) {
+    ssize_t count = read(descriptor_, position + done, size - done);
+    if (count < 0 && errno == EINTR) continue;
+    if (count < 0) throw std::runtime_error("Cannot read shower stream: " + path_ + " (" + std::strerror(errno) + ")");
+    if (count == 0) {
+      if (done == 0) return false;
+      throw std::runtime_error("Shower stream ended inside a record: " + path_);
+    }
+    done += count;
+  }
+
+  return true;
+}
+
+ShowerPtr ShowerStream::Next() {
+  G4AutoLock lock(&mutex_);
+  if (closed_) return nullptr;
+  if (descriptor_ < 0) Open();
+
+  uint64_t record_size = 0;
+  if (!ReadExact(&record_size, sizeof(record_size))) {
+    closed_ = true;
+    LOG_INFO("Shower stream closed after " << shower_num_ << " showers");
+    return nullptr;
+  }
+
+  // the rest of the record must be there once its length is
+  auto read_record = [this](void* buffer, size_t size) {
+    if (!ReadExact(buffer, size)) throw std::runtime_error("Shower stream ended inside a record: " + path_);
+  };
+
+  ShowerFileHeader header;
+  if (record_size < sizeof(header)) throw std::runtime_error("Broken shower record in " + path_);
+  read_record(&header, sizeof(header));
+  CheckShowerHeader(header, path_);
+
+  size_t column_bytes = header.particle_count * sizeof(uint64_t);
+  if (record_size != header.header_size + PARTICLE_COLUMN_NUM * column_bytes) throw std::runtime_error("Broken shower record in " + path_);
+
+  // skip header fields of newer writers
+  std::vector<char> extra(header.header_size - sizeof(header));
+  if (!extra.empty()) read_record(extra.data(), extra.size());
+
+  auto shower = std::make_shared<Shower>();
+  shower->event_id = header.event_id;
+  shower->primary_particle_id = header.primary_particle_id;
+  shower->particle_amount = header.particle_amount;
+  shower->theta = header.theta;
+  shower->phi = header.phi;
+
+  // columns go straight into the shower, no staging buffer
+  Particles& particles = shower->particles;
+  particles.resize(header.particle_count);
+  void* columns[PARTICLE_COLUMN_NUM] = {particles.particle_id.data(), particles.particle_num.data(), particles.x.data(), particles.y.data(),
+                                        particles.z.data(),           particles.px.data(),           particles.py.data(), particles.pz.data(),
+                                        particles.energy.data()};
+  for (auto column: columns)
+    if (column_bytes > 0) read_record(column, column_bytes);
+
+  shower->BindView();
+  shower_num_++;
+
+  return shower;
+}
+
+size_t ShowerStream::GetShowerNumber() {
+  G4AutoLock lock(&mutex_);
+  return shower_num_;
+}
+
+}  // namespace nevod
\ No newline at end of file
@@ -13,47 +13,30 @@ DetectorConstruction::DetectorConstruction(Communicator* communicator): communic
 
   switch (params.config_qsm) {
     case CherenkovConfig::OLD_CONFIGURATION:
-      cwd_plane_number_ = 7;
-      qsm_config_.resize(cwd_plane_number_);
-      stride_config_.resize(cwd_plane_number_);
-      for (G4int i = 0; i < cwd_plane_number_; ++i) {
-        if (i % 2 == 0) {
-          qsm_config_[i] = 4;
-          stride_config_[i] = 4;
-        } else {
-          qsm_config_[i] = 3;
-          stride_config_[i] = 3;
-        }
-      }
+      cwd_layout_ = CWD_OLD_LAYOUT;
       break;
     case CherenkovConfig::NEW_CONFIGURATION:
-      cwd_plane_number_ = 6;
-      qsm_config_.resize(cwd_plane_number_);
-      stride_config_.resize(cwd_plane_number_);
-      for (auto& qsm: qsm_config_)
-        qsm = 4;
-      for (auto& stride: stride_config_)
-        stride = 4;
+      cwd_layout_ = CWD_NEW_LAYOUT;
       break;
   }
 
-  air_tube_log_ = init_vector4d<G4LogicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  air_tube_phys_ = init_vector4d<G4VPhysicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
+  const auto& cwd = cwd_layout_;
+  air_tube_log_ = init_vector4d<G4LogicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  air_tube_phys_ = init_vector4d<G4VPhysicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
 
-  photocathode_log_ = init_vector4d<G4LogicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  photocathode_phys_ = init_vector4d<G4VPhysicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
+  photocathode_log_ = init_vector4d<G4LogicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  photocathode_phys_ = init_vector4d<G4VPhysicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
 
   switch (params.config_sct) {
     case SCTConfig::OLD_CONFIGURATION:
-      sct_plane_number_ = {5, 4};
+      sct_layout_ = SCT_OLD_LAYOUT;
       break;
     case SCTConfig::NEW_CONFIGURATION:
-      sct_plane_number_ = {7, 6};
+      sct_layout_ = SCT_NEW_LAYOUT;
       break;
   }
-  sct_counter_number_ = {4, 5};
 
-  G4int counter_number = (sct_plane_number_.first * sct_counter_number_.first + sct_plane_number_.second * sct_counter_number_.first) * 2;
+  G4int counter_number = sct_layout_.CounterNumber();
   sct_counter_box_.resize(counter_number);
   sct_counter_log_.resize(counter_number);
   sct_counter_phys_.resize(counter_number);
@@ -154,10 +137,10 @@ void DetectorConstruction::ConstructSDandField() {
   sd_manager->AddNewDetector(airtube_sd);
   sd_manager->AddNewDetector(photocathode_sd);
 
-  for (G4int i = 0; i < cwd_plane_number_; ++i)
-    for (G4int j = 0; j < qsm_config_[i]; ++j)
-      for (G4int k = 0; k < stride_config_[i]; ++k)
-        for (G4int l = 0; l < PMT_PER_QSM; ++l) {
+  for (G4int i = 0; i < cwd_layout_.plane_num; ++i)
+    for (G4int j = 0; j < cwd_layout_.StripeNumber(i); ++j)
+      for (G4int k = 0; k < cwd_layout_.ModuleNumber(i); ++k)
+        for (G4int l = 0; l < cwd_layout_.tube_num; ++l) {
           air_tube_log_[i][j][k][l]->SetSensitiveDetector(airtube_sd);
           photocathode_log_[i][j][k][l]->SetSensitiveDetector(photocathode_sd);
         }
@@ -468,6 +451,9 @@ void DetectorConstruction::BuildNEVOD() {
   auto pool_cap_log = new G4LogicalVolume(pool_cap_box, ferrum, "PoolCap");
   G4VPhysicalVolume* pool_cap_phys = new G4PVPlacement(nullptr, pool_cap_pos, pool_cap_log, "PoolCap", world_log_, false, 0, check_overlaps_);
 
+  // pool with its cap encloses the water, CWD and the muon track control planes
+  communicator_->AddAcceptanceBox(pool_pos, G4ThreeVector(pool_x, pool_y, pool_z + 2. * pool_cap_z));
+
   //============================================================================
   // The water box
   //============================================================================
@@ -962,6 +948,7 @@ void DetectorConstruction::BuildCWD() {
   // Buildings construction
   //============================================================================
 
+  const auto& cwd = cwd_layout_;
   std::vector<PMTId> id_qsm;
   G4int pmt_count = 0;
 
@@ -988,32 +975,26 @@ void DetectorConstruction::BuildCWD() {
   rot_matrices[4]->rotateY(180.0 * deg);
   rot_matrices[5]->rotateX(0.0 * deg);
 
-  auto m_box_log = init_vector3d<G4LogicalVolume*>(cwd_plane_number_, 4, 4);
-  auto m_box_a_log = init_vector3d<G4LogicalVolume*>(cwd_plane_number_, 4, 4);
-  auto aluminium_tube_log = init_vector4d<G4LogicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  auto illuminator_log = init_vector4d<G4LogicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  auto silicone_log = init_vector4d<G4LogicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  auto glass_log = init_vector4d<G4LogicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-
-  auto m_box_phys = init_vector3d<G4VPhysicalVolume*>(cwd_plane_number_, 4, 4);
-  auto m_box_a_phys = init_vector3d<G4VPhysicalVolume*>(cwd_plane_number_, 4, 4);
-  auto aluminium_tube_phys = init_vector4d<G4VPhysicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  auto illuminator_phys = init_vector4d<G4VPhysicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  auto silicone_phys = init_vector4d<G4VPhysicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  auto glass_phys = init_vector4d<G4VPhysicalVolume*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-
-  for (G4int plane = 0; plane < cwd_plane_number_; plane++) {
-    for (G4int stripe = 0; stripe < stride_config_[plane]; stripe++) {
-      for (G4int module = 0; module < qsm_config_[plane]; module++) {
-        if ((plane == 0) || (plane == 2) || (plane == 4) || (plane == 6)) {
-          // for fours
-          pos_x = -3.0 + 2.0 * stripe * m;
-          pos_z = 3.0 - 2.0 * module * m;
-        } else {
-          // for threes
-          pos_x = -2.0 + 2.0 * stripe * m;
-          pos_z = 2.0 - 2.0 * module * m;
-        }
+  auto m_box_log = init_vector3d<G4LogicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num);
+  auto m_box_a_log = init_vector3d<G4LogicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num);
+  auto aluminium_tube_log = init_vector4d<G4LogicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  auto illuminator_log = init_vector4d<G4LogicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  auto silicone_log = init_vector4d<G4LogicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  auto glass_log = init_vector4d<G4LogicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+
+  auto m_box_phys = init_vector3d<G4VPhysicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num);
+  auto m_box_a_phys = init_vector3d<G4VPhysicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num);
+  auto aluminium_tube_phys = init_vector4d<G4VPhysicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  auto illuminator_phys = init_vector4d<G4VPhysicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  auto silicone_phys = init_vector4d<G4VPhysicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  auto glass_phys = init_vector4d<G4VPhysicalVolume*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+
+  for (G4int plane = 0; plane < cwd.plane_num; plane++) {
+    for (G4int stripe = 0; stripe < cwd.StripeNumber(plane); stripe++) {
+      for (G4int module = 0; module < cwd.ModuleNumber(plane); module++) {
+        // the offsets follow the number of modules of the plane
+        pos_x = -(cwd.StripeNumber(plane) - 1.0) + 2.0 * stripe * m;
+        pos_z = (cwd.ModuleNumber(plane) - 1.0) - 2.0 * module * m;
         pos_y = -6.125 + 1.25 * plane * m;
         position = G4ThreeVector(pos_x, pos_y, pos_z);
 
@@ -1027,7 +1008,7 @@ void DetectorConstruction::BuildCWD() {
         m_box_a_phys[plane][stripe][module] = new G4PVPlacement(
             nullptr, null_position, m_box_a_log[plane][stripe][module], "MBoxA", m_box_log[plane][stripe][module], false, 0, check_overlaps_);
 
-        for (G4int i = 0; i < PMT_PER_QSM; i++) {
+        for (G4int i = 0; i < cwd.tube_num; i++) {
           distance = (120. + 157. / 2.) * mm;
           position = G4ThreeVector(distance * tube_config[i][0] + pos_x, distance * tube_config[i][1] + pos_y, distance * tube_config[i][2] + pos_z);
           aluminium_tube_log[plane][stripe][module][i] = new G4LogicalVolume(aluminium_tube, aluminium, "Tube");
@@ -1096,14 +1077,10 @@ void DetectorConstruction::BuildCWD() {
               "Photocathode",
               air_tube_log_[plane][stripe][module][i],
               false,
-              pmt_count,
+              PMTChannel::Encode({plane, stripe, module, i}),
               check_overlaps_);
 
-          id_qsm[pmt_count].plane = plane;
-          id_qsm[pmt_count].stripe = stripe;
-          id_qsm[pmt_count].module = module;
-          id_qsm[pmt_count].tube = i;
-
+          id_qsm.push_back({plane, stripe, module, i});
           pmt_count++;
         }
       }
@@ -1129,18 +1106,18 @@ void DetectorConstruction::BuildCWD() {
   optical_plexiglass_tube_surface->SetFinish(polished);
   optical_plexiglass_tube_surface->SetModel(unified);
 
-  auto glass_pmt_surface = init_vector4d<G4LogicalBorderSurface*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  // auto plexiglass_tube_surface = init_vector4d<G4LogicalBorderSurface*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  // auto plexiglass_water_surface = init_vector4d<G4LogicalBorderSurface*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  // auto plexiglass_glass_surface = init_vector4d<G4LogicalBorderSurface*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  // auto glass_tube_surface = init_vector4d<G4LogicalBorderSurface*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  // auto water_tube_surface = init_vector4d<G4LogicalBorderSurface*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-  // auto water_m_box_surface = init_vector4d<G4LogicalBorderSurface*>(cwd_plane_number_, 4, 4, PMT_PER_QSM);
-
-  for (G4int plane = 0; plane < cwd_plane_number_; plane++) {
-    for (G4int stripe = 0; stripe < stride_config_[plane]; stripe++) {
-      for (G4int module = 0; module < qsm_config_[plane]; module++) {
-        for (G4int i = 0; i < PMT_PER_QSM; i++) {
+  auto glass_pmt_surface = init_vector4d<G4LogicalBorderSurface*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  // auto plexiglass_tube_surface = init_vector4d<G4LogicalBorderSurface*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  // auto plexiglass_water_surface = init_vector4d<G4LogicalBorderSurface*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  // auto plexiglass_glass_surface = init_vector4d<G4LogicalBorderSurface*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  // auto glass_tube_surface = init_vector4d<G4LogicalBorderSurface*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  // auto water_tube_surface = init_vector4d<G4LogicalBorderSurface*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+  // auto water_m_box_surface = init_vector4d<G4LogicalBorderSurface*>(cwd.plane_num, cwd.stripe_num, cwd.module_num, cwd.tube_num);
+
+  for (G4int plane = 0; plane < cwd.plane_num; plane++) {
+    for (G4int stripe = 0; stripe < cwd.StripeNumber(plane); stripe++) {
+      for (G4int module = 0; module < cwd.ModuleNumber(plane); module++) {
+        for (G4int i = 0; i < cwd.tube_num; i++) {
           glass_pmt_surface[plane][stripe][module][i] = new G4LogicalBorderSurface(
               "GlassPMTSurface", glass_phys[plane][stripe][module][i], photocathode_phys_[plane][stripe][module][i], optical_plexiglass_tube_surface);
         }
@@ -1261,6 +1238,22 @@ void DetectorConstruction::BuildDECOR() {
       }
     }
   }
+
+  //============================================================================
+  // Sending configuration to Communicator
+  //============================================================================
+
+  for (size_t super_module = 0; super_module < DECOR_COUNT; ++super_module) {
+    std::vector<G4VPhysicalVolume*> volumes;
+    std::vector<G4Box*> boxes;
+    for (size_t plane = 0; plane < DECOR_CHAMBER_COUNT; ++plane) {
+      for (size_t i = 0; i < 2; ++i) {
+        volumes.push_back(super_module_phys_[super_module][plane][i]);
+        boxes.push_back(super_module_box_[super_module][plane][i]);
+      }
+    }
+    SendAcceptanceBox(volumes, boxes);
+  }
 }
 
 // SCT
@@ -1288,10 +1281,6 @@ void DetectorConstruction::BuildSCT() {
   G4double counter_pos_z_upper = (9.6 / 2. + 0.005 + 0.055 / 2.) * m;
   G4double counter_pos_z_down = (-4.5 + 0.055 / 2. + 1.E-6) * m;
 
-  G4int middle_id = (sct_plane_number_.first * sct_counter_number_.first + sct_plane_number_.second * sct_counter_number_.first);
-  G4int counter_per_iter = sct_counter_number_.first + sct_counter_number_.second;
-
-  G4int additional_counter_id;
   G4double counter_pos_z;
 
   G4int counter_id = 0;
@@ -1299,21 +1288,17 @@ void DetectorConstruction::BuildSCT() {
 
   G4ThreeVector null_vector(0.0 * m, 0.0 * m, 0.0 * m);
 
-  for (G4int side_count = 0; side_count < 2; ++side_count) {
+  for (G4int side_count = 0; side_count < sct_layout_.side_num; ++side_count) {
     // top or bottom
-    if (side_count == 0) {
-      additional_counter_id = 0;
-      counter_pos_z = counter_pos_z_upper;
-    } else {
-      additional_counter_id = middle_id;
-      counter_pos_z = counter_pos_z_down;
-    }
+    counter_pos_z = side_count == 0 ? counter_pos_z_upper : counter_pos_z_down;
 
-    for (G4int j = 0; j < sct_plane_number_.first; j++) {
-      counter_id = counter_per_iter * j + additional_counter_id;
-      for (G4int i = 0; i < sct_counter_number_.first; i++) {
-        counter_pos_x = (-4.5 + 1.5 + 2. * i) * m;
-        counter_pos_y = (-13.0 + 5.625 + 2.5 * j) * m;
+    // planes of 4 and 5 counters alternate along y
+    for (G4int j = 0; j < sct_layout_.plane_num; j++) {
+      G4int row_num = sct_layout_.RowNumber(j);
+      for (G4int i = 0; i < row_num; i++) {
+        counter_pos_x = (-(row_num - 1.) + 2. * i) * m;
+        counter_pos_y = (-13.0 + 5.625 + 1.25 * j) * m;
+        G4int channel = SCTChannel::Encode({side_count, j, i});
 
         sct_counter_box_[counter_id].first = new G4Box("Counter", counter_size_x.first / 2., counter_size_y.first / 2., counter_size_z.first / 2.);
         sct_counter_log_[counter_id].first = new G4LogicalVolume(sct_counter_box_[counter_id].first, aluminium, "Counter");
@@ -1324,7 +1309,7 @@ void DetectorConstruction::BuildSCT() {
             "Counter",
             world_log_,
             false,
-            counter_id,
+            channel,
             check_overlaps_);
 
         sct_counter_box_[counter_id].second =
@@ -1337,7 +1322,7 @@ void DetectorConstruction::BuildSCT() {
             "CounterInner",
             sct_counter_log_[counter_id].first,
             false,
-            counter_id,
+            channel,
             check_overlaps_);
 
         sct_scint_box_[counter_id] = new G4Box("ScintillatorSCT", scint_size_x / 2., scint_size_y / 2., scint_size_z / 2.);
@@ -1349,66 +1334,13 @@ void DetectorConstruction::BuildSCT() {
             "ScintillatorSCT",
             sct_counter_log_[counter_id].second,
             false,
-            counter_id,
+            channel,
             check_overlaps_);
 
-        id_sct[counter_id].side = side_count;
-        id_sct[counter_id].plane = j;
-        id_sct[counter_id].row = i;
+        id_sct.push_back(SCTChannel::Decode(channel));
 
         counter_id++;
       }
-
-      for (G4int j = 0; j < sct_plane_number_.second; j++) {
-        counter_id = sct_counter_number_.first + counter_per_iter * j + additional_counter_id;
-        for (G4int i = 0; i < sct_counter_number_.second; i++) {
-          counter_pos_x = (-4.5 + 0.5 + 2. * i) * m;
-          counter_pos_y = (-13.0 + 6.875 + 2.5 * j) * m;
-
-          sct_counter_box_[counter_id].first = new G4Box("Counter", counter_size_x.first / 2., counter_size_y.first / 2., counter_size_z.first / 2.);
-          sct_counter_log_[counter_id].first = new G4LogicalVolume(sct_counter_box_[counter_id].first, aluminium, "Counter");
-          sct_counter_phys_[counter_id].first = new G4PVPlacement(
-              nullptr,
-              G4ThreeVector(counter_pos_x, counter_pos_y, counter_pos_z),
-              sct_counter_log_[counter_id].first,
-              "Counter",
-              world_log_,
-              false,
-              counter_id,
-              check_overlaps_);
-
-          sct_counter_box_[counter_id].second =
-              new G4Box("CounterInner", counter_size_x.second / 2., counter_size_y.second / 2., counter_size_z.second / 2.);
-          sct_counter_log_[counter_id].second = new G4LogicalVolume(sct_counter_box_[counter_id].second, air, "CounterInner");
-          sct_counter_phys_[counter_id].second = new G4PVPlacement(
-              nullptr,
-              null_vector,
-              sct_counter_log_[counter_id].second,
-              "CounterInner",
-              sct_counter_log_[counter_id].first,
-              false,
-              counter_id,
-              check_overlaps_);
-
-          sct_scint_box_[counter_id] = new G4Box("ScintillatorSCT", scint_size_x / 2., scint_size_y / 2., scint_size_z / 2.);
-          sct_scint_log_[counter_id] = new G4LogicalVolume(sct_scint_box_[counter_id], scintillator, "ScintillatorSCT");
-          sct_scint_phys_[counter_id] = new G4PVPlacement(
-              nullptr,
-              null_vector,
-              sct_scint_log_[counter_id],
-              "ScintillatorSCT",
-              sct_counter_log_[counter_id].second,
-              false,
-              counter_id,
-              check_overlaps_);
-
-          id_sct[counter_id].side = side_count;
-          id_sct[counter_id].plane = j;
-          id_sct[counter_id].row = i;
-
-          counter_id++;
-        }
-      }
     }
   }
 
@@ -1416,8 +1348,37 @@ void DetectorConstruction::BuildSCT() {
   // Sending configuration to Communicator
   //============================================================================
 
-  communicator_->SetCountSCT(counter_id);
+  communicator_->SetCountSCT(id_sct.size());
   communicator_->SetCounterId(id_sct);
+
+  std::vector<G4VPhysicalVolume*> volumes;
+  std::vector<G4Box*> boxes;
+  for (size_t i = 0; i < sct_counter_phys_.size(); ++i) {
+    if (sct_counter_phys_[i].first == nullptr) continue;
+    volumes.push_back(sct_counter_phys_[i].first);
+    boxes.push_back(sct_counter_box_[i].first);
+  }
+  SendAcceptanceBox(volumes, boxes);
+}
+
+void DetectorConstruction::SendAcceptanceBox(const std::vector<G4VPhysicalVolume*>& volumes, const std::vector<G4Box*>& boxes) {
+  if (volumes.empty()) return;
+
+  // bounding box of unrotated boxes placed directly in the world
+  G4ThreeVector lower(DBL_MAX, DBL_MAX, DBL_MAX), upper(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+  for (size_t i = 0; i < volumes.size(); ++i) {
+    G4ThreeVector position = volumes[i]->GetTranslation();
+    G4ThreeVector half_size(boxes[i]->GetXHalfLength(), boxes[i]->GetYHalfLength(), boxes[i]->GetZHalfLength());
+
+    lower.setX(std::min(lower.x(), position.x() - half_size.x()));
+    lower.setY(std::min(lower.y(), position.y() - half_size.y()));
+    lower.setZ(std::min(lower.z(), position.z() - half_size.z()));
+    upper.setX(std::max(upper.x(), position.x() + half_size.x()));
+    upper.setY(std::max(upper.y(), position.y() + half_size.y()));
+    upper.setZ(std::max(upper.z(), position.z() + half_size.z()));
+  }
+
+  communicator_->AddAcceptanceBox((lower + upper) / 2., (upper - lower) / 2.);
 }
 
 // PRISMA-URAN
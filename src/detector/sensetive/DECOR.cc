@@ -32,8 +32,8 @@ G4bool DECORSensetiveDetector::ProcessHits(G4Step* step, G4TouchableHistory* his
           if (event_data->phi >= 285.0 && event_data->phi <= 345.0 && i <= 5) set_w = true;
 
           if (side >= 0) {
-            event_data->muon_decor[i][copy_number][side] = 1;
-            if (set_w) event_data->muon_decor_w[i][copy_number][side] = 1;
+            event_data->muon_decor(i, copy_number, side) = 1;
+            if (set_w) event_data->muon_decor_w(i, copy_number, side) = 1;
             break;
           }
         }
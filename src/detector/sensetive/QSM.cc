@@ -42,7 +42,6 @@ PhotocathodeSensetiveDetector::PhotocathodeSensetiveDetector(G4String name, Comm
   // TODO fix this
   minimum_energy_ = 0;
   maximum_energy_ = 70;
-  total_pmt_count_ = communicator_->GetCountPMT();
 }
 
 G4bool PhotocathodeSensetiveDetector::ProcessHits(G4Step* step, G4TouchableHistory* history) {
@@ -59,7 +58,7 @@ G4bool PhotocathodeSensetiveDetector::ProcessHits(G4Step* step, G4TouchableHisto
       // photo effect
       if (quantum_efficiency[energy] > G4UniformRand()) {
         G4int copy_number = track->GetVolume()->GetCopyNo();
-        if (copy_number >= 0 && copy_number < total_pmt_count_) {
+        if (copy_number >= 0 && copy_number < PMTChannel::SIZE) {
           auto event_data = communicator_->GetEventData();
           event_data->photoelectron_num[copy_number]++;
           event_data->particle_count++;
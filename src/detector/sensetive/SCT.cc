@@ -2,9 +2,7 @@
 
 namespace nevod {
 
-SCTSensetiveDetector::SCTSensetiveDetector(G4String name, Communicator* communicator): G4VSensitiveDetector(name), communicator_(communicator) {
-  total_sct_count_ = communicator_->GetCountSCT();
-}
+SCTSensetiveDetector::SCTSensetiveDetector(G4String name, Communicator* communicator): G4VSensitiveDetector(name), communicator_(communicator) {}
 
 G4bool SCTSensetiveDetector::ProcessHits(G4Step* step, G4TouchableHistory* history) {
   const auto* track = step->GetTrack();
@@ -16,11 +14,11 @@ G4bool SCTSensetiveDetector::ProcessHits(G4Step* step, G4TouchableHistory* histo
   if (particle_type == G4MuonPlus::MuonPlusDefinition() || particle_type == G4MuonMinus::MuonMinusDefinition()) {
     if (track_id == 1 && parent_id == 0) {
       auto copy_number = track->GetVolume()->GetCopyNo();
-      auto event_data = communicator_->GetEventData();
-      CounterId id = communicator_->GetCounterId(copy_number);
 
-      if (copy_number >= 0 && copy_number < total_sct_count_)
-        event_data->edep_count_sct[id.side][id.plane][id.row] += step->GetTotalEnergyDeposit() / MeV;
+      if (copy_number >= 0 && copy_number < SCTChannel::SIZE) {
+        CounterId id = SCTChannel::Decode(copy_number);
+        communicator_->GetEventData()->edep_count_sct(id.side, id.plane, id.row) += step->GetTotalEnergyDeposit() / MeV;
+      }
     }
   }
 
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <thread>
+
+#include "G4AutoLock.hh"
+#include "control/Communicator.hh"
+#include "globals.hh"
+
+namespace {
+G4Mutex bench_mutex = G4MUTEX_INITIALIZER;
+}
+
+// Measures the hit path of the sensitive detectors, GetEventData and a channel id decode for
+// every hit, from a growing number of threads. The locked mode serialises every call on one
+// mutex as the Communicator did before its getters became lock-free.
+// Usage: nevod-bench-communicator [hits per thread]
+int main(int argc, char** argv) {
+  size_t hit_num = argc > 1 ? std::stoul(argv[1]) : 10000000;
+
+  // no configuration, output or checkpoints, only the event state of the threads
+  nevod::SimulationParams params;
+  params.save_logs = false;
+  params.log_level = nevod::LogLevel::WARNING;
+  nevod::Communicator communicator(params);
+
+  // every channel of the old configurations, as copy numbers of the hit volumes
+  const auto& cwd = nevod::CWD_OLD_LAYOUT;
+  std::vector<nevod::PMTId> id_qsm;
+  std::vector<G4int> qsm_copy_numbers;
+  for (G4int plane = 0; plane < cwd.plane_num; ++plane)
+    for (G4int stripe = 0; stripe < cwd.StripeNumber(plane); ++stripe)
+      for (G4int module = 0; module < cwd.ModuleNumber(plane); ++module)
+        for (G4int tube = 0; tube < cwd.tube_num; ++tube) {
+          id_qsm.push_back({plane, stripe, module, tube});
+          qsm_copy_numbers.push_back(nevod::PMTChannel::Encode(id_qsm.back()));
+        }
+
+  const auto& sct = nevod::SCT_OLD_LAYOUT;
+  std::vector<nevod::CounterId> id_sct;
+  std::vector<G4int> sct_copy_numbers;
+  for (G4int side = 0; side < sct.side_num; ++side)
+    for (G4int plane = 0; plane < sct.plane_num; ++plane)
+      for (G4int row = 0; row < sct.RowNumber(plane); ++row) {
+        id_sct.push_back({side, plane, row});
+        sct_copy_numbers.push_back(nevod::SCTChannel::Encode(id_sct.back()));
+      }
+
+  communicator.SetCountPMT(id_qsm.size());
+  communicator.SetQSMId(id_qsm);
+  communicator.SetCountSCT(id_sct.size());
+  communicator.SetCounterId(id_sct);
+
+  auto run = [&](size_t thread_num, G4bool locked) {
+    auto worker = [&](G4int thread_id) {
+      G4Threading::G4SetThreadId(thread_id);
+      communicator.AllocateEventData();
+
+      // the old path, a lock and a thread id lookup for the event data and the id table
+      auto contend = [locked]() {
+        if (!locked) return;
+        G4AutoLock lock(&bench_mutex);
+        G4Threading::G4GetThreadId();
+      };
+
+      for (size_t hit = 0; hit < hit_num; ++hit) {
+        contend();
+        nevod::EventData* data = communicator.GetEventData();
+
+        contend();
+        if (hit & 1) {
+          nevod::PMTId id = nevod::PMTChannel::Decode(qsm_copy_numbers[hit % qsm_copy_numbers.size()]);
+          data->amplitude_qsm(id.plane, id.stripe, id.module, id.tube) += 1.;
+        } else {
+          nevod::CounterId id = nevod::SCTChannel::Decode(sct_copy_numbers[hit % sct_copy_numbers.size()]);
+          data->edep_count_sct(id.side, id.plane, id.row) += 1.;
+        }
+      }
+    };
+
+    auto start_time = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < thread_num; ++i)
+      threads.emplace_back(worker, G4int(i));
+    for (auto& thread: threads)
+      thread.join();
+
+    G4double seconds = std::chrono::duration<G4double>(std::chrono::steady_clock::now() - start_time).count();
+    return thread_num * hit_num / std::max(seconds, 1e-9) / 1e6;
+  };
+
+  G4cout << "threads\tlocked Mhits/s\tlock-free Mhits/s\tspeedup" << G4endl;
+  size_t core_num = std::max(G4Threading::G4GetNumberOfCores(), 1);
+  for (size_t thread_num = 1; thread_num <= core_num; thread_num *= 2) {
+    G4double locked = run(thread_num, true);
+    G4double lock_free = run(thread_num, false);
+    G4cout << thread_num << '\t' << locked << '\t' << lock_free << '\t' << lock_free / locked << G4endl;
+  }
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include <atomic>
+#include <thread>
+
+#include "TROOT.h"
+#include "control/InputManager.hh"
+#include "control/ShowerFile.hh"
+#include "globals.hh"
+
+// Converts ROOT shower files (HeaderTree/ParticlesTree) into the native mappable format.
+// Usage: nevod-convert <input file or directory> [output directory]
+int main(int argc, char** argv) {
+  ROOT::EnableThreadSafety();
+
+  if (argc < 2) throw std::invalid_argument("No input file or directory provided");
+
+  fs::path input_path = argv[1];
+  fs::path output_dir = argc > 2 ? fs::path(argv[2]) : fs::path();
+
+  if (!output_dir.empty() && !fs::exists(output_dir)) fs::create_directories(output_dir);
+
+  std::vector<fs::path> files;
+  if (fs::is_directory(input_path)) {
+    for (const auto& entry: fs::recursive_directory_iterator(input_path))
+      if (entry.is_regular_file() && entry.path().extension() == ".root") files.push_back(entry.path());
+  } else {
+    files.push_back(input_path);
+  }
+
+  std::atomic<size_t> next_file{0};
+  std::atomic<size_t> converted{0};
+  std::atomic<size_t> particles{0};
+
+  auto convert = [&]() {
+    for (size_t i = next_file++; i < files.size(); i = next_file++) {
+      try {
+        nevod::DataFile file = nevod::DataFile::FromPath(files[i]);
+        nevod::ShowerPtr shower = nevod::InputManager::ReadShower(file);
+
+        fs::path output_path = (output_dir.empty() ? files[i].parent_path() : output_dir) / files[i].stem();
+        output_path += SHOWER_FILE_EXTENSION;
+        nevod::WriteShowerFile(output_path.string(), *shower);
+
+        converted++;
+        particles += shower->view.size;
+      } catch (const std::exception& error) {
+        G4cerr << "Failed to convert " << files[i].string() << ": " << error.what() << G4endl;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < std::max(std::thread::hardware_concurrency(), 1u); ++i)
+    workers.emplace_back(convert);
+  convert();
+  for (auto& worker: workers)
+    worker.join();
+
+  G4cout << "Converted " << converted << " of " << files.size() << " files (" << particles << " particles)" << G4endl;
+
+  return converted == files.size() ? 0 : 1;
+}
\ No newline at end of file